@@ -0,0 +1,99 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+This work is based on the following paper:
+A Semi-Lossless Steganography Technique for G.711 Telephony Speech
+
+ISBN 978-0-7695-4222-5
+
+Author:
+- Naofumi Aoki
+
+The author of the above mentioned paper does not endorse this work.
+*/
+
+
+#ifndef AOKICAPACITYINDEX_CPP
+#define AOKICAPACITYINDEX_CPP
+
+#include "AokiCapacityIndex.hpp"
+#include <algorithm>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void AokiCapacityIndex::append(bool law, const g711Audio *audio, length_t count) {
+	g711Audio invert = (law == ULAW) ? INVERT_MASK_ULAW : INVERT_MASK_ALAW;
+	bitmap.resize((length + count + 63) / 64, 0);
+	
+	index_t i = 0;
+	
+#ifdef __SSE2__
+	// Whole words of 16 samples at a time once the bitmap is 16-aligned
+	const __m128i invertv = _mm_set1_epi8(invert);
+	const __m128i magnitude = _mm_set1_epi8(SIGN - 1);
+	const __m128i zero = _mm_setzero_si128();
+	
+	for (; (length + i) % 16 && i < count; i++) {
+		if (!((audio[i] ^ invert) & (SIGN - 1))) {
+			bitmap[(length + i) / 64] |= 1ULL << ((length + i) % 64);
+			positions.push_back(length + i);
+		}
+	}
+	
+	for (; i + 16 <= count; i += 16) {
+		__m128i u = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(audio + i)), invertv);
+		unsigned long long zeros = (unsigned int) _mm_movemask_epi8(
+			_mm_cmpeq_epi8(_mm_and_si128(u, magnitude), zero));
+		if (!zeros) continue;
+		
+		index_t at = length + i;
+		bitmap[at / 64] |= zeros << (at % 64);
+		while (zeros) {
+			positions.push_back(at + __builtin_ctzll(zeros));
+			zeros &= zeros - 1;
+		}
+	}
+#endif
+	
+	for (; i < count; i++) {
+		if (!((audio[i] ^ invert) & (SIGN - 1))) {
+			bitmap[(length + i) / 64] |= 1ULL << ((length + i) % 64);
+			positions.push_back(length + i);
+		}
+	}
+	
+	length += count;
+}
+
+void AokiCapacityIndex::appendKnown(const capacityRecord *records, length_t count) {
+	bitmap.resize((length + count + 63) / 64, 0);
+	for (index_t i = 0; i < count; i++) {
+		if (records[i].bits) {
+			bitmap[(length + i) / 64] |= 1ULL << ((length + i) % 64);
+			positions.push_back(length + i);
+		}
+	}
+	length += count;
+}
+
+length_t AokiCapacityIndex::zeroSamplesBefore(index_t index) const {
+	return std::lower_bound(positions.begin(), positions.end(), index) - positions.begin();
+}
+
+#endif
@@ -0,0 +1,91 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+This work is based on the following paper:
+A Semi-Lossless Steganography Technique for G.711 Telephony Speech
+
+ISBN 978-0-7695-4222-5
+
+Author:
+- Naofumi Aoki
+
+The author of the above mentioned paper does not endorse this work.
+*/
+
+
+#ifndef AOKICAPACITYINDEX_HPP
+#define AOKICAPACITYINDEX_HPP
+
+#include "../common/G711Sample.hpp"
+#include "../common/StegAlgorithm.hpp"
+#include <vector>
+
+// Aoki can only hide data in zero-magnitude samples, which depends on
+// nothing but the carrier. This indexes where those samples are, so the
+// capacity of a packet or a whole file is known before embedding.
+class AokiCapacityIndex {
+	private:
+		// Bit (i % 64) of word (i / 64) is set if sample i has zero magnitude
+		std::vector<unsigned long long> bitmap;
+		// Sample indices of the zero-magnitude samples, ascending
+		std::vector<index_t> positions;
+		length_t length;
+		
+	public:
+		AokiCapacityIndex() : length(0) {}
+		
+		// Index count more transmitted bytes, following those already indexed
+		void append(bool law, const g711Audio *audio, length_t count);
+		
+		// Index count more samples, taking whether they can carry data from records
+		void appendKnown(const capacityRecord *records, length_t count);
+		
+		// Forget every indexed sample
+		void clear() {
+			bitmap.clear();
+			positions.clear();
+			length = 0;
+		}
+		
+		// Number of samples indexed
+		length_t samples() const { return length; }
+		
+		// Number of indexed samples that can carry data
+		length_t zeroSamples() const { return positions.size(); }
+		
+		// Whether the given sample can carry data
+		bool isZero(index_t index) const {
+			return index < length && ((bitmap[index / 64] >> (index % 64)) & 1);
+		}
+		
+		// Number of samples before the given one that can carry data
+		length_t zeroSamplesBefore(index_t index) const;
+		
+		// Sample carrying the given hidden bit, or samples() if beyond capacity
+		index_t sampleForBit(unsigned long long bit, length_t bitsPerSample) const {
+			unsigned long long which = bit / bitsPerSample;
+			return which < positions.size() ? positions[which] : length;
+		}
+		
+		// Hidden bits the indexed samples can carry
+		unsigned long long capacity(length_t bitsPerSample) const {
+			return (unsigned long long) positions.size() * bitsPerSample;
+		}
+};
+
+#endif
@@ -33,12 +33,14 @@ The author of the above mentioned paper does not endorse this work.
 #include "../common/G711StegAlgorithm.hpp"
 #include "../common/InitOptions.hpp"
 #include "AokiOptions.hpp"
-#include <list>
+#include "AokiTables.hpp"
+#include "AokiCapacityIndex.hpp"
+#include <deque>
 #include <cmath>
 
-typedef std::list<G711Sample> sampleList;
+typedef std::deque<G711Sample> sampleList;
 
-class AokiStegAlgorithm : public G711StegAlgorithm, public InitOptions {
+class AokiStegAlgorithm final : public G711StegAlgorithm, public InitOptions {
 	friend error_t aokiParser(int key, char *arg, struct argp_state *state);
 	
 	private:
@@ -46,6 +48,15 @@ class AokiStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 		sampleList untamperedSending, tamperedReceiving;
 		g711Audio j;
 		length_t bitsForJ;
+		AokiTables tables;
+		
+		// Zero-magnitude samples among those pushed untampered, indexed from
+		// the first sample pushed since the queue was last empty
+		AokiCapacityIndex untamperedIndex;
+		index_t untamperedPopped;
+		
+		// Which samples still to be pushed can carry data, if known in advance
+		const capacityRecord *knownCapacity;
 		
 		void bitsForZeroMag() {
 			bitsForJ = 1;
@@ -54,45 +65,29 @@ class AokiStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 				tmp >>= 1;
 				bitsForJ++;
 			}
+			tables.build(j, bitsForJ);
 		}
 	
 	protected:		
 		// Inherited functions
 		G711Sample getNewlyTamperedSample(index_t forIndex, steg_t givenSteg) {
 			G711Sample toReturn = getUntamperedOut(forIndex);
-			short signedSample = toReturn.uninvertedSignedSample();
-			int absSignedSample = std::abs(signedSample);
-			
-			if (signedSample == 0) { // can have bits embedded (values [-j,+j])
-				toReturn = G711Sample(
-					toReturn.isAlaw() ? ALAW : ULAW,
-					(givenSteg & j) + ((givenSteg & (j+1)) ? SIGN : 0),
-					false);
-			} else { // push up by j
-				if (absSignedSample + j >= SIGN) // overflow
-					toReturn = G711Sample(
-						toReturn.isAlaw() ? ALAW : ULAW,
-						(signedSample/absSignedSample == -1 ? SIGN : 0) + (SIGN - 1),
-						false);
-				else // no overflow
-					toReturn += j;
-			}
-			
-			return toReturn;
+			bool law = toReturn.isAlaw() ? ALAW : ULAW;
+			return G711Sample(law, tables.embed(law, toReturn.transmissionSample(), givenSteg));
 		}
 		
 		G711Sample getUntamperedOut(index_t index) {
 			if (index >= untamperedSending.size())
 				return G711Sample();
 			
-			sampleList::iterator it = untamperedSending.begin();
-			for (index_t i = 0; i < index; i++) it++;
-			return *it;
+			return untamperedSending[index];
 		}
 		
 	public:
 		AokiStegAlgorithm() {
 			j = 0;
+			untamperedPopped = 0;
+			knownCapacity = NULL;
 			bitsForZeroMag();
 		}
 	
@@ -101,8 +96,28 @@ class AokiStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 			return j + ((j+1) * (getUntamperedOut(index).uninvertedSample() & SIGN ? 0 : 1));
 		}
 		
+		// A zero-magnitude sample left as it was
+		steg_t getQuietestBitPattern(index_t index) {
+			return (j+1) * (getUntamperedOut(index).uninvertedSample() & SIGN ? 1 : 0);
+		}
+		
 		void pushUntamperedSamples(const G711Sample *samples, length_t length) {
-			for (index_t i = 0; i < length; i++) untamperedSending.push_back(samples[i]);
+			g711Audio in[SAMPLES_PER_PACKET];
+			for (index_t done = 0; done < length; done += SAMPLES_PER_PACKET) {
+				length_t run = length - done;
+				if (run > SAMPLES_PER_PACKET) run = SAMPLES_PER_PACKET;
+				
+				for (index_t i = 0; i < run; i++) {
+					untamperedSending.push_back(samples[done + i]);
+					in[i] = samples[done + i].transmissionSample();
+				}
+				if (knownCapacity) {
+					untamperedIndex.appendKnown(knownCapacity, run);
+					knownCapacity += run;
+				} else {
+					untamperedIndex.append(samples[done].isAlaw() ? ALAW : ULAW, in, run);
+				}
+			}
 		}
 		
 		length_t untamperedSamplesReadyForPop() {
@@ -114,25 +129,65 @@ class AokiStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 		}
 		
 		length_t bitsAvailableForEncode(index_t index) {
-			if (getUntamperedOut(index).uninvertedSignedSample() == 0)
+			if (index < untamperedSending.size() && untamperedIndex.isZero(untamperedPopped + index))
 				return bitsForJ;
 			else
 				return 0;
 		}
 		
+		void capacities(length_t *out, length_t count) {
+			for (index_t i = 0; i < count; i++)
+				out[i] = (i < untamperedSending.size() && untamperedIndex.isZero(untamperedPopped + i)) ? bitsForJ : 0;
+		}
+		
+		length_t bitsAvailableTotal() {
+			return (untamperedIndex.zeroSamples() -
+				untamperedIndex.zeroSamplesBefore(untamperedPopped)) * bitsForJ;
+		}
+		
+		// Returns the index of the sample ready for tampering that will carry
+		// the given hidden bit (0 being the first bit of the next sample popped),
+		// or untamperedSamplesReadyForPop() if beyond the capacity of the queue
+		index_t sampleForBit(length_t bit) {
+			length_t skipped = untamperedIndex.zeroSamplesBefore(untamperedPopped) * bitsForJ;
+			return untamperedIndex.sampleForBit(skipped + bit, bitsForJ) - untamperedPopped;
+		}
+		
 		length_t popTamperedSamples(G711Sample *samples, const steg_t *stegData, int *state, length_t length) {
 			length_t size = untamperedSending.size();
 			if (length > size) length = size;
-			for (index_t i = 0; i < length; i++) {
-				samples[i] = getNewlyTamperedSample(0, stegData[i]);
-				untamperedSending.pop_front();
-				state[i] = 0;
+			
+			// Run the table kernel a packet at a time
+			g711Audio in[SAMPLES_PER_PACKET], out[SAMPLES_PER_PACKET];
+			for (index_t done = 0; done < length; done += SAMPLES_PER_PACKET) {
+				length_t run = length - done;
+				if (run > SAMPLES_PER_PACKET) run = SAMPLES_PER_PACKET;
+				
+				bool law = untamperedSending.front().isAlaw() ? ALAW : ULAW;
+				for (index_t i = 0; i < run; i++)
+					in[i] = untamperedSending[i].transmissionSample();
+				
+				tables.embed(law, in, stegData + done, out, run);
+				
+				for (index_t i = 0; i < run; i++) {
+					samples[done + i] = G711Sample(law, out[i]);
+					state[done + i] = 0;
+				}
+				untamperedSending.erase(untamperedSending.begin(), untamperedSending.begin() + run);
+				untamperedPopped += run;
+			}
+			
+			if (untamperedSending.empty()) {
+				untamperedIndex.clear();
+				untamperedPopped = 0;
 			}
 			return length;
 		}
 		
 		void resetUntampered() {
 			untamperedSending.clear();
+			untamperedIndex.clear();
+			untamperedPopped = 0;
 		}
 		
 		void pushTamperedSamples(const G711Sample *samples, length_t length) {
@@ -146,19 +201,21 @@ class AokiStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 		length_t popRecoveredData(steg_t *stegData, length_t *bitLength, int *state, length_t length) {
 			length_t size = tamperedReceiving.size();
 			if (length > size) length = size;
-			for (index_t i = 0; i < length; i++) {
-				G711Sample sample = tamperedReceiving.front();
-				if (std::abs(sample.uninvertedSignedSample()) <= j) {
-					bitLength[i] = bitsForJ;
-					g711Audio uninverted = sample.uninvertedSample();
-					stegData[i] = (uninverted & j) + ((uninverted & SIGN) ? (j+1) : 0);
-				} else {
-					bitLength[i] = 0;
-					stegData[i] = 0;
+			
+			g711Audio in[SAMPLES_PER_PACKET];
+			for (index_t done = 0; done < length; done += SAMPLES_PER_PACKET) {
+				length_t run = length - done;
+				if (run > SAMPLES_PER_PACKET) run = SAMPLES_PER_PACKET;
+				
+				bool law = tamperedReceiving.front().isAlaw() ? ALAW : ULAW;
+				for (index_t i = 0; i < run; i++) {
+					in[i] = tamperedReceiving[i].transmissionSample();
+					state[done + i] = 0;
 				}
 				
-				state[i] = 0;
-				tamperedReceiving.pop_front();
+				tables.extract(law, in, stegData + done, bitLength + done, run);
+				
+				tamperedReceiving.erase(tamperedReceiving.begin(), tamperedReceiving.begin() + run);
 			}
 			return length;
 		}
@@ -167,6 +224,17 @@ class AokiStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 			tamperedReceiving.clear();
 		}
 		
+		// Each sample is tampered with on its own, using nothing else
+		bool isSampleIndependent() { return true; }
+		
+		std::string capacityKey() {
+			return "aoki/" + std::to_string((unsigned int) j);
+		}
+		
+		void useCapacityRecords(const capacityRecord *records) {
+			knownCapacity = records;
+		}
+		
 		// Inherited functions - InitOptions
 		error_t argp(int key, char *arg, struct argp_state *state);
 		
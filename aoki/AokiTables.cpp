@@ -0,0 +1,170 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+This work is based on the following paper:
+A Semi-Lossless Steganography Technique for G.711 Telephony Speech
+
+ISBN 978-0-7695-4222-5
+
+Author:
+- Naofumi Aoki
+
+The author of the above mentioned paper does not endorse this work.
+*/
+
+
+#ifndef AOKITABLES_CPP
+#define AOKITABLES_CPP
+
+#include "AokiTables.hpp"
+#include <cstdlib>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// The per-sample rules from the paper, used only to fill in the tables
+static G711Sample aokiTamper(G711Sample sample, g711Audio j, steg_t givenSteg) {
+	short signedSample = sample.uninvertedSignedSample();
+	int absSignedSample = std::abs(signedSample);
+	bool law = sample.isAlaw() ? ALAW : ULAW;
+	
+	if (signedSample == 0) // can have bits embedded (values [-j,+j])
+		return G711Sample(law, (givenSteg & j) + ((givenSteg & (j+1)) ? SIGN : 0), false);
+	
+	// push up by j
+	if (absSignedSample + j >= SIGN) // overflow
+		return G711Sample(law, (signedSample/absSignedSample == -1 ? SIGN : 0) + (SIGN - 1), false);
+	
+	return sample + j;
+}
+
+void AokiTables::build(g711Audio newJ, length_t newBitsForJ) {
+	j = newJ;
+	bitsForJ = newBitsForJ;
+	stegMask = j + (j+1);
+	
+	for (int l = 0; l < 2; l++) {
+		bool law = l ? ULAW : ALAW;
+		
+		for (int in = 0; in < 256; in++) {
+			G711Sample sample(law, (g711Audio) in);
+			
+			if (sample.uninvertedSignedSample() == 0) {
+				shifted[l][in] = 0;
+				zeroMask[l][in] = 0xFF;
+			} else {
+				shifted[l][in] = aokiTamper(sample, j, 0).transmissionSample();
+				zeroMask[l][in] = 0;
+			}
+			
+			if (std::abs(sample.uninvertedSignedSample()) <= j) {
+				g711Audio uninverted = sample.uninvertedSample();
+				steg_t stegData = (uninverted & j) + ((uninverted & SIGN) ? (j+1) : 0);
+				recovered[l][in] = stegData | (bitsForJ << 8);
+			} else {
+				recovered[l][in] = 0;
+			}
+		}
+		
+		for (steg_t s = 0; s < 128; s++)
+			embedded[l][s] = aokiTamper(G711Sample(law, 0, false), j, s & stegMask).transmissionSample();
+	}
+}
+
+void AokiTables::embed(bool law, const g711Audio *in, const steg_t *stegData, g711Audio *out, length_t length) const {
+	index_t i = 0;
+	
+#ifdef __SSE2__
+	// The same rules, as a saturating add on the magnitude with a select for
+	// zero-magnitude samples, 16 samples at a time
+	const __m128i invert = _mm_set1_epi8(law == ULAW ? INVERT_MASK_ULAW : INVERT_MASK_ALAW);
+	const __m128i sign = _mm_set1_epi8((char) SIGN);
+	const __m128i magnitude = _mm_set1_epi8(SIGN - 1);
+	const __m128i jv = _mm_set1_epi8(j);
+	const __m128i jPlusOne = _mm_set1_epi8(j+1);
+	const __m128i mask = _mm_set1_epi32(stegMask);
+	const __m128i zero = _mm_setzero_si128();
+	
+	for (; i + 16 <= length; i += 16) {
+		__m128i u = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i)), invert);
+		__m128i mag = _mm_and_si128(u, magnitude);
+		__m128i pushed = _mm_or_si128(_mm_and_si128(u, sign),
+			_mm_min_epu8(_mm_adds_epu8(mag, jv), magnitude));
+		
+		__m128i s = _mm_packus_epi16(
+			_mm_packs_epi32(
+				_mm_and_si128(_mm_loadu_si128((const __m128i*)(stegData + i)), mask),
+				_mm_and_si128(_mm_loadu_si128((const __m128i*)(stegData + i + 4)), mask)),
+			_mm_packs_epi32(
+				_mm_and_si128(_mm_loadu_si128((const __m128i*)(stegData + i + 8)), mask),
+				_mm_and_si128(_mm_loadu_si128((const __m128i*)(stegData + i + 12)), mask)));
+		__m128i hidden = _mm_or_si128(_mm_and_si128(s, jv),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(s, jPlusOne), jPlusOne), sign));
+		
+		__m128i isZero = _mm_cmpeq_epi8(mag, zero);
+		__m128i result = _mm_or_si128(_mm_andnot_si128(isZero, pushed), _mm_and_si128(isZero, hidden));
+		_mm_storeu_si128((__m128i*)(out + i), _mm_xor_si128(result, invert));
+	}
+#endif
+	
+	for (; i < length; i++)
+		out[i] = embed(law, in[i], stegData[i]);
+}
+
+void AokiTables::extract(bool law, const g711Audio *in, steg_t *stegData, length_t *bitLength, length_t length) const {
+	index_t i = 0;
+	
+#ifdef __SSE2__
+	const __m128i invert = _mm_set1_epi8(law == ULAW ? INVERT_MASK_ULAW : INVERT_MASK_ALAW);
+	const __m128i sign = _mm_set1_epi8((char) SIGN);
+	const __m128i magnitude = _mm_set1_epi8(SIGN - 1);
+	const __m128i jv = _mm_set1_epi8(j);
+	const __m128i jPlusOne = _mm_set1_epi8(j+1);
+	const __m128i bits = _mm_set1_epi8(bitsForJ);
+	const __m128i zero = _mm_setzero_si128();
+	
+	for (; i + 16 <= length; i += 16) {
+		__m128i u = _mm_xor_si128(_mm_loadu_si128((const __m128i*)(in + i)), invert);
+		__m128i mag = _mm_and_si128(u, magnitude);
+		__m128i carries = _mm_cmpeq_epi8(_mm_min_epu8(mag, jv), mag);
+		
+		__m128i hidden = _mm_and_si128(carries, _mm_or_si128(_mm_and_si128(u, jv),
+			_mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(u, sign), sign), jPlusOne)));
+		__m128i lengths = _mm_and_si128(carries, bits);
+		
+		// Widen both to one 32 bit value per sample
+		__m128i low = _mm_unpacklo_epi8(hidden, zero), high = _mm_unpackhi_epi8(hidden, zero);
+		_mm_storeu_si128((__m128i*)(stegData + i), _mm_unpacklo_epi16(low, zero));
+		_mm_storeu_si128((__m128i*)(stegData + i + 4), _mm_unpackhi_epi16(low, zero));
+		_mm_storeu_si128((__m128i*)(stegData + i + 8), _mm_unpacklo_epi16(high, zero));
+		_mm_storeu_si128((__m128i*)(stegData + i + 12), _mm_unpackhi_epi16(high, zero));
+		
+		low = _mm_unpacklo_epi8(lengths, zero);
+		high = _mm_unpackhi_epi8(lengths, zero);
+		_mm_storeu_si128((__m128i*)(bitLength + i), _mm_unpacklo_epi16(low, zero));
+		_mm_storeu_si128((__m128i*)(bitLength + i + 4), _mm_unpackhi_epi16(low, zero));
+		_mm_storeu_si128((__m128i*)(bitLength + i + 8), _mm_unpacklo_epi16(high, zero));
+		_mm_storeu_si128((__m128i*)(bitLength + i + 12), _mm_unpackhi_epi16(high, zero));
+	}
+#endif
+	
+	for (; i < length; i++)
+		bitLength[i] = extract(law, in[i], &(stegData[i]));
+}
+
+#endif
@@ -0,0 +1,84 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+This work is based on the following paper:
+A Semi-Lossless Steganography Technique for G.711 Telephony Speech
+
+ISBN 978-0-7695-4222-5
+
+Author:
+- Naofumi Aoki
+
+The author of the above mentioned paper does not endorse this work.
+*/
+
+
+#ifndef AOKITABLES_HPP
+#define AOKITABLES_HPP
+
+#include "../common/G711Sample.hpp"
+#include "../common/StegAlgorithm.hpp"
+
+// Index into the tables below for a given law
+#define LAW_INDEX(law) ((law) == ULAW ? 1 : 0)
+
+// Precomputed transmitted-byte mappings for a single j, so whole runs of
+// samples can be tampered and recovered without per-sample branching.
+class AokiTables {
+	private:
+		g711Audio j;
+		length_t bitsForJ;
+		steg_t stegMask;
+		
+		// Tampered byte for each transmitted byte that can't carry data, 0 otherwise
+		g711Audio shifted[2][256];
+		// 0xFF for each transmitted byte that is a zero-magnitude sample, 0 otherwise
+		g711Audio zeroMask[2][256];
+		// Transmitted byte carrying each possible set of hidden bits
+		g711Audio embedded[2][128];
+		// Hidden bits in the low byte and bit length in the high byte, for each transmitted byte
+		unsigned short recovered[2][256];
+		
+	public:
+		AokiTables() { build(0, 1); }
+		
+		// Rebuild the tables for a new j; bitsForJ is the capacity of a zero-magnitude sample
+		void build(g711Audio newJ, length_t newBitsForJ);
+		
+		// Tamper a single transmitted byte, stegData only being used if it can carry data
+		g711Audio embed(bool law, g711Audio in, steg_t stegData) const {
+			int l = LAW_INDEX(law);
+			return shifted[l][in] | (zeroMask[l][in] & embedded[l][stegData & stegMask]);
+		}
+		
+		// Recover the hidden bits from a single transmitted byte, returning their length
+		length_t extract(bool law, g711Audio in, steg_t *stegData) const {
+			unsigned short r = recovered[LAW_INDEX(law)][in];
+			*stegData = r & 0xFF;
+			return r >> 8;
+		}
+		
+		// Tamper length transmitted bytes into out
+		// stegData[i] is only used where in[i] is a zero-magnitude sample
+		void embed(bool law, const g711Audio *in, const steg_t *stegData, g711Audio *out, length_t length) const;
+		
+		// Recover the hidden bits and their lengths from length transmitted bytes
+		void extract(bool law, const g711Audio *in, steg_t *stegData, length_t *bitLength, length_t length) const;
+};
+
+#endif
@@ -0,0 +1,37 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BITASSEMBLER_CPP
+#define BITASSEMBLER_CPP
+
+#include "BitAssembler.hpp"
+
+void BitAssembler::writeBuffer() {
+	if (used) out->write(&buffer[0], used);
+	used = 0;
+}
+
+void BitAssembler::flush() {
+	// The whole bytes of the word go after the buffer, and any bits of a
+	// partial byte stay for later appends
+	if (used + 8 > buffer.size()) writeBuffer();
+	for (; wordBits >= 8; wordBits -= 8, word >>= 8)
+		buffer[used++] = (char) word;
+	writeBuffer();
+	out->flush();
+}
+
+#endif
@@ -0,0 +1,68 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BITASSEMBLER_HPP
+#define BITASSEMBLER_HPP
+
+#include <ostream>
+#include <vector>
+
+#define BIT_ASSEMBLER_BUFFER 65536
+
+// Collects extracted bits, first bit lowest, into the bytes of a file.
+// Each append is one shift and or into a 64 bit word, and whole words go
+// into a buffer that's only written out when full. A last partial byte is
+// never written, as it can only be padding.
+class BitAssembler {
+	private:
+		std::ostream *out;
+		unsigned long long word;
+		unsigned int wordBits;
+		std::vector<char> buffer;
+		size_t used;
+		
+		void putWord(unsigned long long w) {
+			if (used + 8 > buffer.size()) writeBuffer();
+			for (int i = 0; i < 8; i++, w >>= 8)
+				buffer[used++] = (char) w;
+		}
+		
+		void writeBuffer();
+	
+	public:
+		BitAssembler(std::ostream *out, size_t bufferLength = BIT_ASSEMBLER_BUFFER) :
+			out(out), word(0), wordBits(0), buffer(bufferLength < 8 ? 8 : bufferLength), used(0) {}
+		
+		// Adds the low count bits of bits, for count up to 64
+		void append(unsigned long long bits, unsigned int count) {
+			if (count < 64) bits &= (1ULL << count) - 1;
+			word |= bits << wordBits;
+			wordBits += count;
+			if (wordBits >= 64) {
+				putWord(word);
+				wordBits -= 64;
+				// The bits that didn't fit
+				word = wordBits ? bits >> (count - wordBits) : 0;
+			}
+		}
+		
+		// Writes out every whole byte collected so far
+		void flush();
+		
+		~BitAssembler() {}
+};
+
+#endif
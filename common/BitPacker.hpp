@@ -0,0 +1,149 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef BITPACKER_HPP
+#define BITPACKER_HPP
+
+#include "StegAlgorithm.hpp"
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+#define BIT_PACKER_HAVE_BMI2
+#endif
+
+// Samples packed into a word at a time, and the bits each has in it
+#define BIT_PACKER_SAMPLES 8
+#define BIT_PACKER_LANE 8
+
+// Moves payload bits into and out of the hidden data of a run of samples
+// with known capacities: first bit lowest, in sample order, the same as a
+// bit at a time. Up to 8 samples at once share a word, with a byte lane
+// each, and pdep/pext spread or pack the lanes where the CPU has BMI2;
+// shifts do otherwise. Samples with more bits than a lane holds are done
+// one at a time.
+
+// The bits of each lane the capacities cover, and how many there are
+// Returns false if any capacity doesn't fit in a lane
+inline bool bitPackerMask(const length_t *capacities, length_t count,
+	unsigned long long *mask, length_t *total) {
+	*mask = 0;
+	*total = 0;
+	for (index_t i = 0; i < count; i++) {
+		if (capacities[i] > BIT_PACKER_LANE) return false;
+		*mask |= ((1ULL << capacities[i]) - 1) << (i * BIT_PACKER_LANE);
+		*total += capacities[i];
+	}
+	return true;
+}
+
+#ifdef BIT_PACKER_HAVE_BMI2
+__attribute__((target("bmi2")))
+inline unsigned long long depositLanesBMI2(unsigned long long bits, unsigned long long mask) {
+	return _pdep_u64(bits, mask);
+}
+
+__attribute__((target("bmi2")))
+inline unsigned long long extractLanesBMI2(unsigned long long lanes, unsigned long long mask) {
+	return _pext_u64(lanes, mask);
+}
+
+// Checked once, as the LSB kernel checks for AVX2
+inline bool bitPackerUseBMI2() {
+	static const bool supported = __builtin_cpu_supports("bmi2");
+	return supported;
+}
+#endif
+
+// Spreads the low bits of bits over the lanes of mask
+inline unsigned long long depositLanes(unsigned long long bits, unsigned long long mask,
+	const length_t *capacities, length_t count) {
+#ifdef BIT_PACKER_HAVE_BMI2
+	if (bitPackerUseBMI2())
+		return depositLanesBMI2(bits, mask);
+#endif
+	(void) mask;
+	unsigned long long lanes = 0;
+	for (index_t i = 0; i < count; i++) {
+		lanes |= (bits & ((1ULL << capacities[i]) - 1)) << (i * BIT_PACKER_LANE);
+		bits >>= capacities[i];
+	}
+	return lanes;
+}
+
+// Packs the lanes of mask down into the low bits
+inline unsigned long long extractLanes(unsigned long long lanes, unsigned long long mask,
+	const length_t *lengths, length_t count) {
+#ifdef BIT_PACKER_HAVE_BMI2
+	if (bitPackerUseBMI2())
+		return extractLanesBMI2(lanes, mask);
+#endif
+	(void) mask;
+	unsigned long long bits = 0;
+	length_t shift = 0;
+	for (index_t i = 0; i < count; i++) {
+		bits |= ((lanes >> (i * BIT_PACKER_LANE)) & ((1ULL << lengths[i]) - 1)) << shift;
+		shift += lengths[i];
+	}
+	return bits;
+}
+
+// Fills hiddenData with the next capacities[i] bits of source for each of
+// count samples, returning how many bits were taken
+// Bits needs nextBits(count), as BitProvider has
+template <class Bits>
+length_t scatterBits(Bits *source, const length_t *capacities, length_t count, steg_t *hiddenData) {
+	length_t taken = 0;
+	for (index_t i = 0; i < count; i += BIT_PACKER_SAMPLES) {
+		length_t group = (count - i < BIT_PACKER_SAMPLES) ? count - i : BIT_PACKER_SAMPLES;
+		unsigned long long mask;
+		length_t total;
+		
+		if (bitPackerMask(capacities + i, group, &mask, &total)) {
+			unsigned long long lanes = depositLanes(source->nextBits(total), mask, capacities + i, group);
+			for (index_t j = 0; j < group; j++)
+				hiddenData[i + j] = (steg_t) ((lanes >> (j * BIT_PACKER_LANE)) & 0xFF);
+			taken += total;
+		} else {
+			for (index_t j = i; j < i + group; j++) {
+				hiddenData[j] = (steg_t) source->nextBits(capacities[j]);
+				taken += capacities[j];
+			}
+		}
+	}
+	return taken;
+}
+
+// Gives sink(bits, bitCount) the low lengths[i] bits of hiddenData for
+// each of count samples, up to 64 bits at a time
+template <class Sink>
+void gatherBits(const steg_t *hiddenData, const length_t *lengths, length_t count, Sink sink) {
+	for (index_t i = 0; i < count; i += BIT_PACKER_SAMPLES) {
+		length_t group = (count - i < BIT_PACKER_SAMPLES) ? count - i : BIT_PACKER_SAMPLES;
+		unsigned long long mask;
+		length_t total;
+		
+		if (bitPackerMask(lengths + i, group, &mask, &total)) {
+			unsigned long long lanes = 0;
+			for (index_t j = 0; j < group; j++)
+				lanes |= (unsigned long long) (hiddenData[i + j] & 0xFF) << (j * BIT_PACKER_LANE);
+			sink(extractLanes(lanes, mask, lengths + i, group), total);
+		} else {
+			for (index_t j = i; j < i + group; j++)
+				sink(hiddenData[j] & ((1ULL << lengths[j]) - 1), lengths[j]);
+		}
+	}
+}
+
+#endif
@@ -25,6 +25,16 @@ class BitProvider {
 	public:
 		virtual length_t remainingBits() = 0;
 		virtual bool nextBit() = 0;
+		
+		// The next count bits (up to 64), the first in the lowest bit
+		// The same as calling nextBit count times, which it does by default
+		virtual unsigned long long nextBits(unsigned int count) {
+			unsigned long long bits = 0;
+			for (unsigned int i = 0; i < count; i++)
+				if (nextBit()) bits |= 1ULL << i;
+			return bits;
+		}
+		
 		virtual ~BitProvider() {}
 };
 
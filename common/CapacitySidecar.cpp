@@ -0,0 +1,115 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAPACITYSIDECAR_CPP
+#define CAPACITYSIDECAR_CPP
+
+#include "CapacitySidecar.hpp"
+#include <fstream>
+#include <cstring>
+
+unsigned long long CapacitySidecar::hash(const g711Audio *carrier, unsigned long long samples) {
+	unsigned long long h = 14695981039346656037ULL;
+	for (unsigned long long i = 0; i < samples; i++) {
+		h ^= carrier[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+void CapacitySidecar::fillHeader(capacitySidecarHeader *header, const std::string &key,
+	bool law, const g711Audio *carrier, unsigned long long samples) {
+	memset(header, 0, sizeof(*header));
+	memcpy(header->magic, CAPACITY_SIDECAR_MAGIC, sizeof(CAPACITY_SIDECAR_MAGIC));
+	header->version = CAPACITY_SIDECAR_VERSION;
+	header->law = law;
+	header->samples = samples;
+	header->carrierHash = hash(carrier, samples);
+	strncpy(header->key, key.c_str(), CAPACITY_SIDECAR_KEY_LENGTH - 1);
+}
+
+bool CapacitySidecar::open(const char *fileName, const std::string &key, bool law,
+	const g711Audio *carrier, unsigned long long samples) {
+	MappedFile *mapped = new MappedFile(fileName);
+	if ((!mapped->isOpen()) ||
+		(mapped->size() != sizeof(capacitySidecarHeader) + samples * sizeof(capacityRecord))) {
+			delete mapped;
+			return false;
+		}
+	
+	// Only hash the carrier once the file looks plausible
+	capacitySidecarHeader expected;
+	fillHeader(&expected, key, law, carrier, samples);
+	if (memcmp(mapped->data(), &expected, sizeof(expected))) {
+		delete mapped;
+		return false;
+	}
+	
+	if (file) delete file;
+	file = mapped;
+	sidecarRecords = (const capacityRecord*) (file->data() + sizeof(expected));
+	return true;
+}
+
+void CapacitySidecar::build(G711StegAlgorithm *algorithm, bool law, const g711Audio *carrier,
+	unsigned long long samples, std::vector<capacityRecord> *records) {
+	G711Sample in[SAMPLES_PER_PACKET], out[SAMPLES_PER_PACKET];
+	steg_t noData[SAMPLES_PER_PACKET] = { 0 };
+	int state[SAMPLES_PER_PACKET];
+	
+	records->clear();
+	records->reserve(samples);
+	
+	// As when reporting capacity: push a packet, record what's ready, pop it untouched
+	for (unsigned long long done = 0; done < samples; done += SAMPLES_PER_PACKET) {
+		length_t count = SAMPLES_PER_PACKET;
+		if (done + count > samples) count = samples - done;
+		
+		for (index_t i = 0; i < count; i++)
+			in[i] = G711Sample(law, carrier[done + i]);
+		algorithm->pushUntamperedSamples(in, count);
+		
+		length_t ready;
+		while ((ready = algorithm->untamperedSamplesReadyForPop())) {
+			if (ready > SAMPLES_PER_PACKET) ready = SAMPLES_PER_PACKET;
+			for (index_t i = 0; i < ready; i++) {
+				capacityRecord record;
+				algorithm->recordCapacity(i, &record);
+				records->push_back(record);
+			}
+			if (!algorithm->popTamperedSamples(out, noData, state, ready)) break;
+		}
+	}
+}
+
+bool CapacitySidecar::write(const char *fileName, const std::string &key, bool law,
+	const g711Audio *carrier, unsigned long long samples,
+	const std::vector<capacityRecord> &records) {
+	if (records.size() != samples) return false;
+	
+	capacitySidecarHeader header;
+	fillHeader(&header, key, law, carrier, samples);
+	
+	std::ofstream out(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!out.is_open()) return false;
+	out.write((const char*) &header, sizeof(header));
+	if (samples)
+		out.write((const char*) &records[0], samples * sizeof(capacityRecord));
+	return out.good();
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CAPACITYSIDECAR_HPP
+#define CAPACITYSIDECAR_HPP
+
+#include "G711StegAlgorithm.hpp"
+#include "MappedFile.hpp"
+#include <string>
+#include <vector>
+
+#define CAPACITY_SIDECAR_MAGIC "G711CAP"
+#define CAPACITY_SIDECAR_VERSION 1
+#define CAPACITY_SIDECAR_KEY_LENGTH 64
+
+// Layout of the start of a capacity sidecar (.cap) file. The header is
+// followed by one capacityRecord per carrier sample.
+typedef struct capacitySidecarHeaderS {
+	char magic[8];
+	unsigned int version;
+	unsigned int law;
+	unsigned long long samples;
+	unsigned long long carrierHash; // FNV-1a of the carrier bytes
+	char key[CAPACITY_SIDECAR_KEY_LENGTH]; // Algorithm and options, from capacityKey()
+} capacitySidecarHeader;
+
+// The per-sample analysis of an algorithm for a carrier, saved so that
+// embedding again into the same carrier with the same options can skip it.
+// Files are mapped rather than read, and only used if the header matches
+// the carrier and algorithm exactly.
+class CapacitySidecar {
+	private:
+		MappedFile *file;
+		const capacityRecord *sidecarRecords;
+		
+		static void fillHeader(capacitySidecarHeader *header, const std::string &key,
+			bool law, const g711Audio *carrier, unsigned long long samples);
+		
+	public:
+		CapacitySidecar() : file(NULL), sidecarRecords(NULL) {}
+		
+		// Map a sidecar; fails if it doesn't exist or doesn't match
+		bool open(const char *fileName, const std::string &key, bool law,
+			const g711Audio *carrier, unsigned long long samples);
+		
+		// Records for every carrier sample, once opened
+		const capacityRecord* records() { return sidecarRecords; }
+		
+		// Run a fresh algorithm instance over the whole carrier, recording its analysis
+		static void build(G711StegAlgorithm *algorithm, bool law, const g711Audio *carrier,
+			unsigned long long samples, std::vector<capacityRecord> *records);
+		
+		// Write records built for a carrier to a sidecar
+		static bool write(const char *fileName, const std::string &key, bool law,
+			const g711Audio *carrier, unsigned long long samples,
+			const std::vector<capacityRecord> &records);
+		
+		static unsigned long long hash(const g711Audio *carrier, unsigned long long samples);
+		
+		~CapacitySidecar() {
+			if (file) delete file;
+		}
+};
+
+#endif
@@ -0,0 +1,97 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CARRIERFILE_CPP
+#define CARRIERFILE_CPP
+
+#include "CarrierFile.hpp"
+
+CarrierReader::CarrierReader(const char *fileName) :
+	file(NULL), isWaveFile(false), samples(NULL), length(0), position(0) {
+	file = new MappedFile(fileName);
+	if (!file->isOpen()) {
+		delete file;
+		file = NULL;
+		return;
+	}
+	
+	isWaveFile = WaveFile::parse(file->data(), file->size(), &info);
+	if (isWaveFile) {
+		samples = file->data() + info.dataOffset;
+		length = info.dataLength;
+	} else {
+		samples = file->data();
+		length = file->size();
+	}
+}
+
+length_t CarrierReader::read(bool law, G711Sample *samplesOut, length_t count) {
+	if (position + count > length) count = length - position;
+	
+	for (index_t i = 0; i < count; i++)
+		samplesOut[i] = G711Sample(law, samples[position + i]);
+	
+	position += count;
+	return count;
+}
+
+void CarrierReader::close() {
+	if (file) delete file;
+	file = NULL;
+	samples = NULL;
+	length = position = 0;
+}
+
+CarrierWriter::CarrierWriter(std::ofstream *out, unsigned short format) :
+	out(out), format(format), samples(0) {
+	if (format) {
+		WaveFile::header(format, 0, &headerBytes);
+		out->write((char*) &headerBytes[0], headerBytes.size());
+	}
+}
+
+void CarrierWriter::put(const G711Sample *from, length_t count) {
+	unsigned char bytes[CARRIER_WRITE_CHUNK * 2];
+	length_t perSample = bytesPerSample();
+	
+	while (count) {
+		length_t chunk = (count < CARRIER_WRITE_CHUNK) ? count : CARRIER_WRITE_CHUNK;
+		for (index_t i = 0; i < chunk; i++)
+			encode(from[i], bytes + i * perSample);
+		out->write((char*) bytes, chunk * perSample);
+		
+		samples += chunk;
+		from += chunk;
+		count -= chunk;
+	}
+}
+
+void CarrierWriter::finish(unsigned long long samplesWritten) {
+	if (!format) return;
+	
+	unsigned long long dataLength = samplesWritten * bytesPerSample();
+	if (dataLength & 1) {
+		out->seekp(headerBytes.size() + dataLength);
+		out->put(0);
+	}
+	
+	WaveFile::header(format, samplesWritten, &headerBytes);
+	out->seekp(0);
+	out->write((char*) &headerBytes[0], headerBytes.size());
+}
+
+#endif
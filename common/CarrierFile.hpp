@@ -0,0 +1,117 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CARRIERFILE_HPP
+#define CARRIERFILE_HPP
+
+#include "G711Sample.hpp"
+#include "StegAlgorithm.hpp"
+#include "MappedFile.hpp"
+#include "WaveFile.hpp"
+#include <fstream>
+#include <vector>
+
+// Samples encoded at a time by CarrierWriter::put(samples, count)
+#define CARRIER_WRITE_CHUNK 512
+
+// A G711 carrier on disk - either raw samples, or wrapped in a WAV file.
+// The file is mapped, and samples are read straight from the mapping.
+class CarrierReader {
+	private:
+		MappedFile *file;
+		bool isWaveFile;
+		waveInfo info;
+		const g711Audio *samples;
+		unsigned long long length, position;
+		
+		// Not copyable - see MappedFile
+		CarrierReader(const CarrierReader&);
+		CarrierReader& operator=(const CarrierReader&);
+		
+	public:
+		CarrierReader(const char *fileName);
+		
+		bool isOpen() const { return file != NULL; }
+		
+		// The header, if a WAV file
+		bool isWave() const { return isWaveFile; }
+		const waveInfo& wave() const { return info; }
+		
+		// The samples, without any header
+		const g711Audio* data() const { return samples; }
+		unsigned long long size() const { return length; }
+		
+		// Hint that samples will be read out of order, rather than by read()
+		void adviseRandom() { if (file) file->adviseRandom(); }
+		
+		// Read up to count samples from where the last read left off
+		length_t read(bool law, G711Sample *samplesOut, length_t count);
+		
+		void close();
+		
+		~CarrierReader() { close(); }
+};
+
+// Writes tampered samples out, raw or as a WAV file of G711 or 16-bit PCM.
+// A WAV header is written up front and rewritten by finish() once the
+// number of samples is known.
+class CarrierWriter {
+	private:
+		std::ofstream *out;
+		unsigned short format; // 0 for raw
+		unsigned long long samples;
+		std::vector<unsigned char> headerBytes;
+		
+	public:
+		// format is 0 for raw G711, or one of the WAVE_FORMAT_ values
+		CarrierWriter(std::ofstream *out, unsigned short format);
+		
+		// Where the first sample goes, and how many bytes each takes
+		length_t headerLength() const { return headerBytes.size(); }
+		length_t bytesPerSample() const { return (format == WAVE_FORMAT_PCM) ? 2 : 1; }
+		
+		// Fill bytesPerSample() bytes with a sample as it will be written
+		void encode(const G711Sample &sample, unsigned char *bytes) const {
+			if (format == WAVE_FORMAT_PCM) {
+				linearAudio linear = sample.linearSample();
+				bytes[0] = linear & 0xFF;
+				bytes[1] = (linear >> 8) & 0xFF;
+			} else {
+				bytes[0] = sample.transmissionSample();
+			}
+		}
+		
+		void put(const G711Sample &sample) {
+			if (format == WAVE_FORMAT_PCM) {
+				unsigned char bytes[2];
+				encode(sample, bytes);
+				out->write((char*) bytes, 2);
+			} else {
+				out->put((char) sample.transmissionSample());
+			}
+			samples++;
+		}
+		
+		// Write count samples at once
+		void put(const G711Sample *samples, length_t count);
+		
+		// Rewrite the header once samplesWritten samples are in the file -
+		// whether by put() or written at headerLength() by other means
+		void finish(unsigned long long samplesWritten);
+};
+
+#endif
@@ -0,0 +1,199 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKEMBEDDER_CPP
+#define CHUNKEMBEDDER_CPP
+
+#include "ChunkEmbedder.hpp"
+#include <unistd.h>
+#include <thread>
+#include <iostream>
+
+ChunkEmbedder::ChunkEmbedder(const std::vector<G711StegAlgorithm*> &workers,
+	const g711Audio *carrier, length_t carrierLength, bool law,
+	const unsigned char *payload, unsigned long long payloadBytes,
+	int outputFd, const CarrierWriter *writer, length_t chunkLength, length_t blockLength,
+	bool statistics) :
+		workers(workers), carrier(carrier), carrierLength(carrierLength), law(law),
+		payload(payload), payloadBits(payloadBytes * 8), outputFd(outputFd), writer(writer),
+		chunkLength(chunkLength), blockLength(blockLength), statistics(statistics), failed(false),
+		processedSamples(0), processedHiddenBits(0) {
+	chunks = (carrierLength + chunkLength - 1) / chunkLength;
+	chunkCapacity.assign(chunks, 0);
+	chunkStartBit.assign(chunks, 0);
+	chunkSamples.assign(chunks, 0);
+	chunkBits.assign(chunks, 0);
+	chunkMetrics.resize(chunks);
+	chunkLatency.resize(chunks);
+}
+
+void ChunkEmbedder::capacityWorker(index_t worker) {
+	G711StegAlgorithm *algorithm = workers[worker];
+	std::vector<G711Sample> samples(chunkLength);
+	
+	for (index_t chunk = worker; chunk < chunks; chunk += workers.size()) {
+		index_t start = chunk * chunkLength;
+		length_t count = carrierLength - start;
+		if (count > chunkLength) count = chunkLength;
+		
+		for (index_t i = 0; i < count; i++)
+			samples[i] = G711Sample(law, carrier[start + i]);
+		
+		algorithm->pushUntamperedSamples(&samples[0], count);
+		chunkCapacity[chunk] = algorithm->bitsAvailableTotal();
+		algorithm->resetUntampered();
+	}
+}
+
+bool ChunkEmbedder::embedChunk(G711StegAlgorithm *algorithm, index_t chunk,
+	G711Sample *samples, steg_t *hiddenData, length_t *hiddenDataLength, int *state,
+	steg_t *recoveredData, length_t *recoveredLength, unsigned char *out) {
+	index_t start = chunk * chunkLength;
+	length_t count = carrierLength - start;
+	if (count > chunkLength) count = chunkLength;
+	
+	for (index_t i = 0; i < count; i++)
+		samples[i] = G711Sample(law, carrier[start + i]);
+	algorithm->pushUntamperedSamples(samples, count);
+	
+	// As when embedding serially, a sample is only embedded (and written)
+	// if some of the payload is left for it; bits past the end are zero
+	unsigned long long bit = chunkStartBit[chunk];
+	length_t embedded = 0;
+	algorithm->capacities(hiddenDataLength, count);
+	for (; (embedded < count) && (bit < payloadBits); embedded++) {
+		hiddenData[embedded] = 0;
+		for (index_t b = 0; b < hiddenDataLength[embedded]; b++, bit++)
+			if ((bit < payloadBits) && ((payload[bit >> 3] >> (bit & 7)) & 1))
+				hiddenData[embedded] |= 1 << b;
+	}
+	
+	embedded = algorithm->popTamperedSamples(samples, hiddenData, state, embedded);
+	algorithm->resetUntampered();
+	
+	// Verify embedded data
+	algorithm->pushTamperedSamples(samples, embedded);
+	length_t recovered = algorithm->popRecoveredData(recoveredData, recoveredLength, state, embedded);
+	algorithm->resetTampered();
+	if (recovered != embedded) {
+		std::cout << "[ChunkEmbedder] Corruption detected: chunk " << chunk << " recovered "
+			<< recovered << " of " << embedded << " samples" << std::endl;
+		return false;
+	}
+	for (index_t i = 0; i < embedded; i++) {
+		steg_t mask = (1 << hiddenDataLength[i]) - 1;
+		if (hiddenDataLength[i] != recoveredLength[i]) {
+			std::cout << "[ChunkEmbedder] Corruption detected: expected length "
+				<< hiddenDataLength[i] << "; got length " << recoveredLength[i] << std::endl;
+			return false;
+		} else if ((hiddenData[i] & mask) != (recoveredData[i] & mask)) {
+			std::cout << "[ChunkEmbedder] Corruption detected: expected data "
+				<< (hiddenData[i] & mask) << "; got data " << (recoveredData[i] & mask) << std::endl;
+			return false;
+		}
+	}
+	
+	for (index_t i = 0; i < embedded; i++)
+		writer->encode(samples[i], out + i * writer->bytesPerSample());
+	
+	// Statistics a packet at a time, decoded to linear first
+	if (statistics) {
+		linearAudio original[SAMPLES_PER_PACKET], modified[SAMPLES_PER_PACKET];
+		for (index_t packet = 0; packet < embedded; packet += SAMPLES_PER_PACKET) {
+			length_t packetCount = embedded - packet;
+			if (packetCount > SAMPLES_PER_PACKET) packetCount = SAMPLES_PER_PACKET;
+			
+			for (index_t i = 0; i < packetCount; i++) {
+				original[i] = G711Sample(law, carrier[start + packet + i]).linearSample();
+				modified[i] = samples[packet + i].linearSample();
+				
+				// Without lookahead, a sample only waits for the rest of its block
+				index_t blockEnd = ((start + packet + i) / blockLength + 1) * blockLength;
+				if (blockEnd > carrierLength) blockEnd = carrierLength;
+				chunkLatency[chunk].add(blockEnd - 1 - (start + packet + i));
+			}
+			chunkMetrics[chunk].add(original, modified, packetCount);
+		}
+		chunkMetrics[chunk].finish();
+	}
+	chunkSamples[chunk] = embedded;
+	chunkBits[chunk] = bit - chunkStartBit[chunk];
+	
+	length_t bytes = embedded * writer->bytesPerSample();
+	off_t offset = writer->headerLength() + (off_t) start * writer->bytesPerSample();
+	for (length_t written = 0; written < bytes; ) {
+		ssize_t result = pwrite(outputFd, out + written, bytes - written, offset + written);
+		if (result <= 0) {
+			std::cout << "[ChunkEmbedder] Couldn't write chunk " << chunk << std::endl;
+			return false;
+		}
+		written += result;
+	}
+	
+	return true;
+}
+
+void ChunkEmbedder::embedWorker(index_t worker) {
+	std::vector<G711Sample> samples(chunkLength);
+	std::vector<steg_t> hiddenData(chunkLength), recoveredData(chunkLength);
+	std::vector<length_t> hiddenDataLength(chunkLength), recoveredLength(chunkLength);
+	std::vector<int> state(chunkLength);
+	std::vector<unsigned char> out(chunkLength * writer->bytesPerSample());
+	
+	for (index_t chunk = worker; (chunk < chunks) && (!failed); chunk += workers.size()) {
+		// Chunks starting past the end of the payload are left out
+		if (chunkStartBit[chunk] >= payloadBits) break;
+		
+		if (!embedChunk(workers[worker], chunk, &samples[0], &hiddenData[0], &hiddenDataLength[0],
+			&state[0], &recoveredData[0], &recoveredLength[0], &out[0]))
+				failed = true;
+	}
+}
+
+bool ChunkEmbedder::run() {
+	std::vector<std::thread> threads;
+	
+	// First pass: capacity of each chunk
+	for (index_t w = 0; w < workers.size(); w++)
+		threads.push_back(std::thread(&ChunkEmbedder::capacityWorker, this, w));
+	for (index_t w = 0; w < workers.size(); w++)
+		threads[w].join();
+	threads.clear();
+	
+	for (index_t chunk = 1; chunk < chunks; chunk++)
+		chunkStartBit[chunk] = chunkStartBit[chunk - 1] + chunkCapacity[chunk - 1];
+	
+	// Second pass: embed each chunk from its starting bit
+	for (index_t w = 0; w < workers.size(); w++)
+		threads.push_back(std::thread(&ChunkEmbedder::embedWorker, this, w));
+	for (index_t w = 0; w < workers.size(); w++)
+		threads[w].join();
+	
+	if (failed) return false;
+	
+	// Totals, in sample order
+	for (index_t chunk = 0; chunk < chunks; chunk++) {
+		processedSamples += chunkSamples[chunk];
+		processedHiddenBits += chunkBits[chunk];
+		metrics.merge(chunkMetrics[chunk]);
+		latency.merge(chunkLatency[chunk]);
+	}
+	
+	return true;
+}
+
+#endif
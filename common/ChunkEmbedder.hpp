@@ -0,0 +1,86 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef CHUNKEMBEDDER_HPP
+#define CHUNKEMBEDDER_HPP
+
+#include "G711StegAlgorithm.hpp"
+#include "QualityMetrics.hpp"
+#include "LatencyHistogram.hpp"
+#include "CarrierFile.hpp"
+#include <vector>
+#include <atomic>
+
+// Smallest chunk worth handing to a worker, in packets
+#define CHUNK_MIN_PACKETS 256
+
+// Embeds a file into a carrier split into chunks, each worker thread taking
+// every n-th chunk with its own algorithm instance. Only suitable where
+// isSampleIndependent() is true, as each chunk starts from a fresh instance.
+// A first pass finds each chunk's capacity, and a prefix sum of those gives
+// the payload bit each chunk starts at, so the chunks can then be embedded,
+// verified and written (with pwrite) in any order.
+// Output is the same as embedding serially; writer says where samples go in
+// the output file and how they are written, but isn't written to itself.
+class ChunkEmbedder {
+	private:
+		std::vector<G711StegAlgorithm*> workers;
+		const g711Audio *carrier;
+		length_t carrierLength;
+		bool law;
+		const unsigned char *payload;
+		unsigned long long payloadBits;
+		int outputFd;
+		const CarrierWriter *writer;
+		length_t chunkLength, blockLength;
+		bool statistics;
+		
+		length_t chunks;
+		std::vector<unsigned long long> chunkCapacity, chunkStartBit, chunkBits;
+		std::vector<length_t> chunkSamples;
+		std::vector<QualityMetrics> chunkMetrics;
+		std::vector<LatencyHistogram> chunkLatency;
+		std::atomic<bool> failed; // Set by any worker
+		
+		void capacityWorker(index_t worker);
+		void embedWorker(index_t worker);
+		bool embedChunk(G711StegAlgorithm *algorithm, index_t chunk,
+			G711Sample *samples, steg_t *hiddenData, length_t *hiddenDataLength, int *state,
+			steg_t *recoveredData, length_t *recoveredLength, unsigned char *out);
+		
+	public:
+		// Totals, as kept by main when embedding serially
+		length_t processedSamples;
+		unsigned long long processedHiddenBits;
+		QualityMetrics metrics;
+		LatencyHistogram latency;
+		
+		// workers must each be a separate instance, set up the same, with nothing pushed
+		// payload bits are taken least significant bit of each byte first
+		// latency is as if read blockLength samples at a time
+		// Without statistics, metrics and latency are left empty
+		ChunkEmbedder(const std::vector<G711StegAlgorithm*> &workers,
+			const g711Audio *carrier, length_t carrierLength, bool law,
+			const unsigned char *payload, unsigned long long payloadBytes,
+			int outputFd, const CarrierWriter *writer, length_t chunkLength, length_t blockLength,
+			bool statistics);
+		
+		// Embeds the whole payload; returns false if verification or writing failed
+		bool run();
+};
+
+#endif
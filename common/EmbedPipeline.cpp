@@ -0,0 +1,329 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EMBEDPIPELINE_CPP
+#define EMBEDPIPELINE_CPP
+
+#include "EmbedPipeline.hpp"
+#include "BitPacker.hpp"
+#include <thread>
+#include <chrono>
+#include <deque>
+
+typedef std::chrono::steady_clock pipelineClock;
+
+static double secondsSince(pipelineClock::time_point start) {
+	return std::chrono::duration<double>(pipelineClock::now() - start).count();
+}
+
+static void resetStage(pipelineStage *stage, const char *name) {
+	stage->name = name;
+	stage->packets = stage->samples = 0;
+	stage->busySeconds = stage->waitSeconds = 0;
+}
+
+EmbedPipeline::EmbedPipeline(G711StegAlgorithm *embedder, G711StegAlgorithm *verifier,
+	BitProvider *bitSource, CarrierReader *audio, bool law,
+	length_t readLength, sampleReader read,
+	CarrierWriter *output, std::ofstream *detailed, bool statistics,
+	length_t packetsInFlight) :
+		embedder(embedder), verifier(verifier), bitSource(bitSource),
+		audio(audio), law(law), readLength(readLength), read(read),
+		output(output), detailed(detailed), statistics(statistics || detailed),
+		readPool(packetsInFlight), embedPool(packetsInFlight),
+		readQueue(packetsInFlight), readFree(packetsInFlight),
+		embedQueue(packetsInFlight), verifyQueue(packetsInFlight), embedFree(packetsInFlight),
+		failed(false), stopReading(false),
+		processedSamples(0), processedHiddenBits(0) {
+	
+	// Every packet starts out free, so recycling one never has to wait
+	for (index_t i = 0; i < packetsInFlight; i++) {
+		readPool[i].originals.resize(readLength);
+		readFree.tryPush(&readPool[i]);
+		embedFree.tryPush(&embedPool[i]);
+	}
+	
+	resetStage(&reading, "reader");
+	resetStage(&embedding, "embedder");
+	resetStage(&verifying, "verifier");
+	resetStage(&writing, "writer");
+}
+
+bool EmbedPipeline::waitPush(SPSCQueue<PipelinePacket*> *queue, PipelinePacket *packet,
+	pipelineStage *stage, std::atomic<bool> *stop) {
+	if (queue->tryPush(packet)) return true;
+	
+	pipelineClock::time_point start = pipelineClock::now();
+	while (!queue->tryPush(packet)) {
+		if (*stop) {
+			stage->waitSeconds += secondsSince(start);
+			return false;
+		}
+		std::this_thread::yield();
+	}
+	stage->waitSeconds += secondsSince(start);
+	return true;
+}
+
+bool EmbedPipeline::waitPop(SPSCQueue<PipelinePacket*> *queue, PipelinePacket **packet,
+	pipelineStage *stage, std::atomic<bool> *stop) {
+	if (queue->tryPop(packet)) return true;
+	
+	pipelineClock::time_point start = pipelineClock::now();
+	while (!queue->tryPop(packet)) {
+		if (*stop) {
+			stage->waitSeconds += secondsSince(start);
+			return false;
+		}
+		std::this_thread::yield();
+	}
+	stage->waitSeconds += secondsSince(start);
+	return true;
+}
+
+void EmbedPipeline::readStage() {
+	pipelineClock::time_point start = pipelineClock::now();
+	PipelinePacket *packet;
+	
+	while (waitPop(&readFree, &packet, &reading, &stopReading)) {
+		packet->count = read(audio, law, &packet->originals[0], readLength);
+		packet->last = !packet->count;
+		
+		if (!waitPush(&readQueue, packet, &reading, &stopReading)) break;
+		if (packet->last) break;
+		
+		reading.packets++;
+		reading.samples += packet->count;
+	}
+	
+	reading.busySeconds = secondsSince(start) - reading.waitSeconds;
+}
+
+void EmbedPipeline::embedStage() {
+	pipelineClock::time_point start = pipelineClock::now();
+	std::deque<G711Sample> originals;
+	steg_t hiddenData[SAMPLES_PER_PACKET];
+	length_t hiddenDataLength[SAMPLES_PER_PACKET];
+	PipelinePacket *in, *out = NULL;
+	unsigned long long pushed = 0, popped = 0;
+	
+	// As when embedding serially, stop reading once the bits run out
+	while ((!failed) && (bitSource->remainingBits())) {
+		if (!waitPop(&readQueue, &in, &embedding, &failed)) break;
+		if (in->last) break;
+		
+		if (statistics)
+			originals.insert(originals.end(), in->originals.begin(), in->originals.begin() + in->count);
+		embedder->pushUntamperedSamples(&in->originals[0], in->count);
+		pushed += in->count;
+		readFree.tryPush(in);
+		
+		if ((!out) && (!waitPop(&embedFree, &out, &embedding, &failed))) break;
+		out->clear();
+		
+		while ((embedder->untamperedSamplesReadyForPop()) && (bitSource->remainingBits())) {
+			length_t sampleCount = embedder->minimumSamplesForPop();
+			if (sampleCount > SAMPLES_PER_PACKET) {
+				std::cout << "[Pipeline] Buffer length exceeded for algorithm minimum" << std::endl;
+				failed = true;
+				break;
+			}
+			
+			embedder->capacities(hiddenDataLength, sampleCount);
+			processedHiddenBits += scatterBits(bitSource, hiddenDataLength, sampleCount, hiddenData);
+			
+			length_t at = out->count;
+			out->tampered.resize(at + sampleCount);
+			out->state.resize(at + sampleCount);
+			sampleCount = embedder->popTamperedSamples(&out->tampered[at], hiddenData, &out->state[at], sampleCount);
+			out->tampered.resize(at + sampleCount);
+			out->state.resize(at + sampleCount);
+			
+			out->hiddenData.insert(out->hiddenData.end(), hiddenData, hiddenData + sampleCount);
+			out->hiddenDataLength.insert(out->hiddenDataLength.end(), hiddenDataLength, hiddenDataLength + sampleCount);
+			out->count += sampleCount;
+			
+			if (statistics) {
+				out->originals.insert(out->originals.end(), originals.begin(), originals.begin() + sampleCount);
+				originals.erase(originals.begin(), originals.begin() + sampleCount);
+				for (index_t i = 0; i < sampleCount; i++, popped++)
+					latency.add(pushed - 1 - popped);
+			}
+		}
+		
+		// Packets with nothing popped are kept for next time
+		if (out->count) {
+			embedding.packets++;
+			embedding.samples += out->count;
+			if (!waitPush(&embedQueue, out, &embedding, &failed)) break;
+			out = NULL;
+		}
+	}
+	
+	stopReading = true;
+	
+	// Let the later stages know there's nothing more
+	if ((!out) && (!waitPop(&embedFree, &out, &embedding, &failed))) out = NULL;
+	if (out) {
+		out->clear();
+		out->last = true;
+		waitPush(&embedQueue, out, &embedding, &failed);
+	}
+	
+	embedding.busySeconds = secondsSince(start) - embedding.waitSeconds;
+}
+
+void EmbedPipeline::verifyStage() {
+	pipelineClock::time_point start = pipelineClock::now();
+	std::deque<steg_t> verifyEmbedData;
+	std::deque<length_t> verifyEmbedLength;
+	std::vector<steg_t> hiddenData;
+	std::vector<length_t> hiddenDataLength;
+	std::vector<int> state;
+	PipelinePacket *packet;
+	
+	while (waitPop(&embedQueue, &packet, &verifying, &failed)) {
+		if (packet->last) {
+			waitPush(&verifyQueue, packet, &verifying, &failed);
+			break;
+		}
+		
+		verifyEmbedData.insert(verifyEmbedData.end(), packet->hiddenData.begin(), packet->hiddenData.end());
+		verifyEmbedLength.insert(verifyEmbedLength.end(), packet->hiddenDataLength.begin(), packet->hiddenDataLength.end());
+		verifier->pushTamperedSamples(&packet->tampered[0], packet->count);
+		
+		length_t sampleCount = verifier->recoveredDataReadyForPop();
+		hiddenData.resize(sampleCount + 1);
+		hiddenDataLength.resize(sampleCount + 1);
+		state.resize(sampleCount + 1);
+		sampleCount = verifier->popRecoveredData(&hiddenData[0], &hiddenDataLength[0], &state[0], sampleCount);
+		
+		for (index_t i = 0; i < sampleCount; i++) {
+			steg_t expData = verifyEmbedData.front();
+			length_t expLen = verifyEmbedLength.front();
+			steg_t actData = hiddenData[i];
+			length_t actLen = hiddenDataLength[i];
+			verifyEmbedData.pop_front();
+			verifyEmbedLength.pop_front();
+			
+			if (expLen != actLen) {
+				std::cout << "[Pipeline] Corruption detected: expected length "
+					<< expLen << "; got length " << actLen << std::endl;
+				failed = true;
+			} else {
+				steg_t hiddenDataMask = (1 << expLen) - 1;
+				if ((expData & hiddenDataMask) != (actData & hiddenDataMask)) {
+					std::cout << "[Pipeline] Corruption detected: expected data "
+						<< (expData & hiddenDataMask) << "; got data " << (actData & hiddenDataMask) << std::endl;
+					failed = true;
+				}
+			}
+			if (failed) break;
+		}
+		if (failed) break;
+		
+		verifying.packets++;
+		verifying.samples += packet->count;
+		if (!waitPush(&verifyQueue, packet, &verifying, &failed)) break;
+	}
+	
+	verifying.busySeconds = secondsSince(start) - verifying.waitSeconds;
+}
+
+void EmbedPipeline::writeStage() {
+	pipelineClock::time_point start = pipelineClock::now();
+	PipelinePacket *packet;
+	
+	// Each packet decoded to linear, for the metrics to take at once
+	std::vector<linearAudio> original, modified;
+	
+	while (waitPop(&verifyQueue, &packet, &writing, &failed)) {
+		if (packet->last) break;
+		
+		output->put(packet->tampered.data(), packet->count);
+		processedSamples += packet->count;
+		writing.packets++;
+		writing.samples += packet->count;
+		
+		if (!statistics) {
+			embedFree.tryPush(packet);
+			continue;
+		}
+		
+		if (original.size() < packet->count) {
+			original.resize(packet->count);
+			modified.resize(packet->count);
+		}
+		for (index_t i = 0; i < packet->count; i++) {
+			original[i] = packet->originals[i].linearSample();
+			modified[i] = packet->tampered[i].linearSample();
+		}
+		metrics.add(original.data(), modified.data(), packet->count);
+		
+		if (detailed) {
+			for (index_t i = 0; i < packet->count; i++) {
+				*detailed << (processedSamples - packet->count + i + 1) << "\t";
+				*detailed << packet->originals[i].uninvertedSignedSample() << "\t";
+				*detailed << packet->state[i] << "\t";
+				*detailed << packet->tampered[i].uninvertedSignedSample() << "\t";
+				*detailed << (packet->hiddenData[i] & ((1 << packet->hiddenDataLength[i]) - 1)) << "\t";
+				*detailed << packet->hiddenDataLength[i] << "\t";
+				if (original[i])
+					*detailed << NoiseTotals::sampleNSR(original[i], modified[i]) << std::endl;
+				else
+					*detailed << "n/a" << std::endl;
+			}
+		}
+		embedFree.tryPush(packet);
+	}
+	
+	metrics.finish();
+	writing.busySeconds = secondsSince(start) - writing.waitSeconds;
+}
+
+bool EmbedPipeline::run() {
+	std::thread reader(&EmbedPipeline::readStage, this);
+	std::thread verification(&EmbedPipeline::verifyStage, this);
+	std::thread writer(&EmbedPipeline::writeStage, this);
+	
+	embedStage();
+	
+	reader.join();
+	verification.join();
+	writer.join();
+	
+	return !failed;
+}
+
+void EmbedPipeline::report(std::ostream *out) {
+	pipelineStage *stages[] = { &reading, &embedding, &verifying, &writing };
+	pipelineStage *bottleneck = stages[0];
+	
+	for (index_t i = 0; i < 4; i++) {
+		pipelineStage *stage = stages[i];
+		*out << "[Pipeline] " << stage->name << ": " << stage->packets << " packets, "
+			<< stage->samples << " samples, busy " << stage->busySeconds << "s ("
+			<< (stage->busySeconds > 0 ? stage->samples / stage->busySeconds : 0)
+			<< " samples/s), waiting " << stage->waitSeconds << "s" << std::endl;
+		if (stage->busySeconds > bottleneck->busySeconds)
+			bottleneck = stage;
+	}
+	
+	*out << "[Pipeline] Bottleneck: " << bottleneck->name << std::endl;
+}
+
+#endif
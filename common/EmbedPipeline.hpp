@@ -0,0 +1,127 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EMBEDPIPELINE_HPP
+#define EMBEDPIPELINE_HPP
+
+#include "G711StegAlgorithm.hpp"
+#include "BitProvider.hpp"
+#include "SPSCQueue.hpp"
+#include "QualityMetrics.hpp"
+#include "LatencyHistogram.hpp"
+#include "CarrierFile.hpp"
+#include <vector>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+
+// Reads up to count samples from carrier into samplesOut, returning how many were read
+typedef length_t (*sampleReader)(CarrierReader *carrier, bool law, G711Sample *samplesOut, length_t count);
+
+// A run of samples on its way between pipeline stages. Read packets only
+// fill originals; embedded packets fill everything.
+class PipelinePacket {
+	public:
+		length_t count;
+		bool last; // Nothing follows this packet (which may be empty)
+		std::vector<G711Sample> originals, tampered;
+		std::vector<steg_t> hiddenData;
+		std::vector<length_t> hiddenDataLength;
+		std::vector<int> state;
+		
+		PipelinePacket() : count(0), last(false) {}
+		
+		void clear() {
+			count = 0;
+			last = false;
+			originals.clear();
+			tampered.clear();
+			hiddenData.clear();
+			hiddenDataLength.clear();
+			state.clear();
+		}
+};
+
+// How much work a stage did, and how long it spent doing it or waiting on
+// its neighbours. The stage busy for longest is the bottleneck.
+typedef struct pipelineStageS {
+	const char *name;
+	unsigned long long packets, samples;
+	double busySeconds, waitSeconds;
+} pipelineStage;
+
+// Embeds with each step on its own thread: a reader, the embedder (which
+// runs on the calling thread), a verifier with its own algorithm instance
+// for the tampered side, and a writer that also keeps any statistics.
+// Stages pass packets through bounded lock-free queues, and used packets
+// go back to the stage that fills them, so memory use is fixed.
+// Output is the same as embedding serially.
+class EmbedPipeline {
+	private:
+		G711StegAlgorithm *embedder, *verifier;
+		BitProvider *bitSource;
+		CarrierReader *audio;
+		bool law;
+		length_t readLength;
+		sampleReader read;
+		CarrierWriter *output;
+		std::ofstream *detailed;
+		bool statistics;
+		
+		std::vector<PipelinePacket> readPool, embedPool;
+		SPSCQueue<PipelinePacket*> readQueue, readFree, embedQueue, verifyQueue, embedFree;
+		
+		// failed stops every stage; stopReading also stops the reader
+		// once the embedder has all it needs
+		std::atomic<bool> failed, stopReading;
+		
+		void readStage();
+		void embedStage();
+		void verifyStage();
+		void writeStage();
+		
+		// Wait for room in, or something from, a queue - giving up if stop is set
+		bool waitPush(SPSCQueue<PipelinePacket*> *queue, PipelinePacket *packet,
+			pipelineStage *stage, std::atomic<bool> *stop);
+		bool waitPop(SPSCQueue<PipelinePacket*> *queue, PipelinePacket **packet,
+			pipelineStage *stage, std::atomic<bool> *stop);
+		
+	public:
+		pipelineStage reading, embedding, verifying, writing;
+		
+		// Totals, as kept by main when embedding serially
+		length_t processedSamples, processedHiddenBits;
+		QualityMetrics metrics;
+		LatencyHistogram latency;
+		
+		// verifier must be a separate instance, set up the same as embedder
+		// detailed may be NULL if no detailed statistics are wanted.
+		// Without statistics, originals aren't kept or decoded at all.
+		EmbedPipeline(G711StegAlgorithm *embedder, G711StegAlgorithm *verifier,
+			BitProvider *bitSource, CarrierReader *audio, bool law,
+			length_t readLength, sampleReader read,
+			CarrierWriter *output, std::ofstream *detailed, bool statistics,
+			length_t packetsInFlight = 8);
+		
+		// Embeds the whole file; returns false if verification failed
+		bool run();
+		
+		// Writes a line per stage with its throughput and time spent waiting
+		void report(std::ostream *out);
+};
+
+#endif
@@ -22,7 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <iostream>
 #include <fstream>
 
-class FileBitProvider : public BitProvider {
+class FileBitProvider final : public BitProvider {
 	private:
 		std::ifstream inputFile;
 		unsigned char currentByte, currentMask;
@@ -74,6 +74,33 @@ class FileBitProvider : public BitProvider {
 			return toReturn;
 		}
 		
+		unsigned long long nextBits(unsigned int count) {
+			// Near the end, nextBit notes where the file runs out
+			if (count > remainingBits())
+				return BitProvider::nextBits(count);
+			
+			unsigned long long bits = 0;
+			unsigned int have = 0;
+			for (; currentMask && (have < count); have++) {
+				if (currentByte & currentMask) bits |= 1ULL << have;
+				currentMask <<= 1;
+			}
+			
+			// Whole bytes at once
+			unsigned char bytes[8];
+			unsigned int byteCount = (count - have) / 8;
+			if (byteCount) {
+				inputFile.read((char*) bytes, byteCount);
+				remainingBytes -= byteCount;
+				for (unsigned int i = 0; i < byteCount; i++, have += 8)
+					bits |= (unsigned long long) bytes[i] << have;
+			}
+			
+			for (; have < count; have++)
+				if (nextBit()) bits |= 1ULL << have;
+			return bits;
+		}
+		
 		virtual ~FileBitProvider() {
 			inputFile.close();
 		}
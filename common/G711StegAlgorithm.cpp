@@ -43,4 +43,26 @@ steg_t G711StegAlgorithm::getNoisiestBitPattern(index_t index) {
 	return bits;
 }
 
+// Likewise naive - the first of every bit pattern with the least noise
+steg_t G711StegAlgorithm::getQuietestBitPattern(index_t index) {
+	G711Sample thisSample = getUntamperedOut(index);
+	length_t bitCount = bitsAvailableForEncode(index);
+	steg_t bits = 0;
+	if (bitCount > 0) {
+		length_t options = 2;
+		for (index_t i = 1; i < bitCount; i++)
+			options *= 2;
+		
+		linearAudio leastNoise = abs(thisSample.linearDifference(getNewlyTamperedSample(index, 0)));
+		for (steg_t i = 1; i < options; i++) {
+			linearAudio thisNoise = abs(thisSample.linearDifference(getNewlyTamperedSample(index, i)));
+			if (thisNoise < leastNoise) {
+				leastNoise = thisNoise;
+				bits = i;
+			}
+		}
+	}
+	return bits;
+}
+
 #endif
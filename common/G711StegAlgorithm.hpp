@@ -23,8 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 // Provides some naive defaults for a G711 steganography algorithm
 class G711StegAlgorithm : public StegAlgorithm<G711Sample> {
-	friend steg_t getNoisiestExtremePatternOnly(index_t index, G711StegAlgorithm *on);
-	friend class WorstNoiseBitProvider;
+	template <class Algo> friend steg_t getNoisiestExtremePatternOnly(index_t index, Algo *on);
 	
 	protected:
 		// Should return the given sample tampered with the given steg data
@@ -39,6 +38,10 @@ class G711StegAlgorithm : public StegAlgorithm<G711Sample> {
 		// the original sample should be returned
 		// Works on samples not yet tampered, does not modify
 		virtual steg_t getNoisiestBitPattern(index_t index);
+		
+		// Should return the quietest bit pattern that can be encoded in a
+		// sample, the opposite of getNoisiestBitPattern
+		virtual steg_t getQuietestBitPattern(index_t index);
 };
 
 #endif
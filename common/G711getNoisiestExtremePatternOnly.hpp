@@ -19,7 +19,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define G711GETNOISIESTEXTREMEPATTERNONLY_HPP
 
 #include "G711StegAlgorithm.hpp"
+#include <cstdlib>
 
-steg_t getNoisiestExtremePatternOnly(index_t index, G711StegAlgorithm *on);
+// For algorithms where the noisiest pattern will be all 0s or 1s
+// Called with the algorithm's own class, so its calls are bound statically
+// where they're final
+template <class Algo>
+steg_t getNoisiestExtremePatternOnly(index_t index, Algo *on) {
+	G711Sample thisSample = on->getUntamperedOut(index);
+	length_t bitCount = on->bitsAvailableForEncode(index);
+	steg_t bits = 0;
+	if (bitCount > 0) {
+		linearAudio lowNoise = thisSample.linearDifference(on->getNewlyTamperedSample(index, 0));
+		linearAudio highNoise = thisSample.linearDifference(on->getNewlyTamperedSample(index, ~0));
+		if (abs(highNoise) > abs(lowNoise)) bits = ~0;
+	}
+	return bits;
+}
 
 #endif
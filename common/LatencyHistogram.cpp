@@ -0,0 +1,62 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCYHISTOGRAM_CPP
+#define LATENCYHISTOGRAM_CPP
+
+#include "LatencyHistogram.hpp"
+#include <cmath>
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+	if (other.counts.size() > counts.size()) counts.resize(other.counts.size());
+	for (index_t i = 0; i < other.counts.size(); i++)
+		counts[i] += other.counts[i];
+	total += other.total;
+}
+
+length_t LatencyHistogram::percentile(double percent) const {
+	if (!total) return 0;
+	
+	unsigned long long rank = (unsigned long long) ceil(percent / 100 * total);
+	if (rank < 1) rank = 1;
+	
+	unsigned long long seen = 0;
+	for (index_t i = 0; i < counts.size(); i++) {
+		seen += counts[i];
+		if (seen >= rank) return i;
+	}
+	return counts.size() - 1;
+}
+
+void LatencyHistogram::write(std::ostream *out) const {
+	double msPerSample = 1000.0 / SAMPLES_PER_SECOND;
+	
+	*out << std::fixed;
+	*out << "Latency median ms:\t" << percentile(50) * msPerSample << std::endl;
+	*out << "Latency 95th percentile ms:\t" << percentile(95) * msPerSample << std::endl;
+	*out << "Latency maximum ms:\t" << percentile(100) * msPerSample << std::endl;
+	
+	for (index_t bin = 0; bin * LATENCY_BIN_SAMPLES < counts.size(); bin++) {
+		unsigned long long inBin = 0;
+		for (index_t i = bin * LATENCY_BIN_SAMPLES; (i < (bin + 1) * LATENCY_BIN_SAMPLES) && (i < counts.size()); i++)
+			inBin += counts[i];
+		if (inBin)
+			*out << "Latency histogram ms " << bin << "-" << (bin + 1) << ":\t" << inBin << std::endl;
+	}
+}
+
+#endif
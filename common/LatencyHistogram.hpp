@@ -0,0 +1,56 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LATENCYHISTOGRAM_HPP
+#define LATENCYHISTOGRAM_HPP
+
+#include "G711Sample.hpp"
+#include "StegAlgorithm.hpp"
+#include <ostream>
+#include <vector>
+
+// Histogram bins in the summary: 1ms
+#define LATENCY_BIN_SAMPLES (SAMPLES_PER_SECOND / 1000)
+
+// How long each embedded sample would have been held up live, in samples:
+// from its own arrival until it was given back tampered. That is the rest
+// of the block it was read in (it can't be pushed before the block is
+// complete), plus whatever the algorithm waits for after it.
+class LatencyHistogram {
+	private:
+		std::vector<unsigned long long> counts; // By latency in samples
+		unsigned long long total;
+		
+	public:
+		LatencyHistogram() : total(0) {}
+		
+		void add(length_t samples) {
+			if (samples >= counts.size()) counts.resize(samples + 1);
+			counts[samples]++;
+			total++;
+		}
+		
+		void merge(const LatencyHistogram &other);
+		
+		// Nearest rank, in samples
+		length_t percentile(double percent) const;
+		
+		// Summary file lines: percentiles, then every 1ms bin with anything in it
+		void write(std::ostream *out) const;
+};
+
+#endif
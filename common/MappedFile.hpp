@@ -0,0 +1,154 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstddef>
+#include <vector>
+
+// Read at a time from a pipe or FIFO, which can't be mapped
+#define MAPPED_FILE_STREAM_CHUNK 65536
+
+// A whole file mapped read-only into memory, unmapped when this goes away.
+// Lets large carriers be read at any offset without reading what's before it.
+// Anything other than a regular file (a pipe, FIFO or device) has no size
+// to map, so it is read to the end into memory instead.
+class MappedFile {
+	private:
+		int fd;
+		unsigned char *base;
+		size_t length;
+		std::vector<unsigned char> streamed; // When not mapped
+		
+		// Reads fd to the end; returns false on a read error
+		bool readStream() {
+			ssize_t got;
+			do {
+				size_t used = streamed.size();
+				streamed.resize(used + MAPPED_FILE_STREAM_CHUNK);
+				got = read(fd, &streamed[used], MAPPED_FILE_STREAM_CHUNK);
+				streamed.resize(used + ((got > 0) ? got : 0));
+			} while (got > 0);
+			
+			length = streamed.size();
+			if (length) base = &streamed[0];
+			return got == 0;
+		}
+		
+		// Not copyable - only one owner should unmap
+		MappedFile(const MappedFile&);
+		MappedFile& operator=(const MappedFile&);
+		
+	public:
+		MappedFile(const char *fileName) : fd(-1), base(NULL), length(0) {
+			fd = open(fileName, O_RDONLY);
+			if (fd < 0) return;
+			
+			struct stat info;
+			if (fstat(fd, &info) != 0) {
+				close(fd);
+				fd = -1;
+				return;
+			}
+			
+			if (!S_ISREG(info.st_mode)) {
+				if (!readStream()) {
+					close(fd);
+					fd = -1;
+					base = NULL;
+					length = 0;
+				}
+				return;
+			}
+			
+			length = info.st_size;
+			if (!length) return; // An empty file can't be mapped, but is valid
+			
+			void *mapped = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+			if (mapped == MAP_FAILED) {
+				close(fd);
+				fd = -1;
+				length = 0;
+				return;
+			}
+			base = (unsigned char*) mapped;
+		}
+		
+		bool isOpen() const { return fd >= 0; }
+		const unsigned char* data() const { return base; }
+		size_t size() const { return length; }
+		
+		// Hint that pages will be touched out of order (e.g. by packet index)
+		void adviseRandom() {
+			if ((base) && (streamed.empty())) madvise(base, length, MADV_RANDOM);
+		}
+		
+		~MappedFile() {
+			if ((base) && (streamed.empty())) munmap(base, length);
+			if (fd >= 0) close(fd);
+		}
+};
+
+// A file created (or emptied) at a given size and mapped for writing,
+// so that parts of it can be filled in any order by any thread.
+class MappedOutputFile {
+	private:
+		int fd;
+		unsigned char *base;
+		size_t length;
+		
+		MappedOutputFile(const MappedOutputFile&);
+		MappedOutputFile& operator=(const MappedOutputFile&);
+		
+	public:
+		MappedOutputFile(const char *fileName, size_t size) : fd(-1), base(NULL), length(size) {
+			fd = open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+			if (fd < 0) return;
+			
+			if ((ftruncate(fd, length) != 0) || (!length)) {
+				if (length) {
+					close(fd);
+					fd = -1;
+				}
+				return;
+			}
+			
+			void *mapped = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			if (mapped == MAP_FAILED) {
+				close(fd);
+				fd = -1;
+				return;
+			}
+			base = (unsigned char*) mapped;
+		}
+		
+		bool isOpen() const { return fd >= 0; }
+		unsigned char* data() { return base; }
+		size_t size() const { return length; }
+		
+		~MappedOutputFile() {
+			if (base) munmap(base, length);
+			if (fd >= 0) close(fd);
+		}
+};
+
+#endif
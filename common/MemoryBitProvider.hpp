@@ -0,0 +1,65 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef MEMORYBITPROVIDER_HPP
+#define MEMORYBITPROVIDER_HPP
+
+#include "BitProvider.hpp"
+
+// The bits of a payload already in memory (read or mapped once by the
+// caller, who keeps it), in the same order as FileBitProvider gives them.
+// Each provider has only its own position, so any number can share one
+// payload without opening it again.
+class MemoryBitProvider final : public BitProvider {
+	private:
+		const unsigned char *payload;
+		unsigned long long bitLength, position;
+	
+	public:
+		MemoryBitProvider(const unsigned char *payload, unsigned long long bytes) :
+			payload(payload), bitLength(bytes * 8), position(0) {}
+		
+		length_t remainingBits() {
+			unsigned long long remaining = bitLength - position;
+			return (remaining > (length_t) ~0) ? (length_t) ~0 : (length_t) remaining;
+		}
+		
+		bool nextBit() {
+			if (position >= bitLength) return false;
+			bool bit = (payload[position >> 3] >> (position & 7)) & 1;
+			position++;
+			return bit;
+		}
+		
+		// Past the end, the rest are zeros
+		unsigned long long nextBits(unsigned int count) {
+			unsigned long long bits = 0;
+			unsigned int have = 0;
+			
+			for (; (have < count) && (position < bitLength) && (position & 7); have++)
+				if (nextBit()) bits |= 1ULL << have;
+			
+			// Whole bytes at once
+			for (; (count - have >= 8) && (bitLength - position >= 8); have += 8, position += 8)
+				bits |= (unsigned long long) payload[position >> 3] << have;
+			
+			for (; have < count; have++)
+				if (nextBit()) bits |= 1ULL << have;
+			return bits;
+		}
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NOISEBITPROVIDER_HPP
+#define NOISEBITPROVIDER_HPP
+
+#include <list>
+#include "BitProvider.hpp"
+#include "G711StegAlgorithm.hpp"
+
+// This class will "expect" that the flow of operations will
+// go as follows:
+// - Optionally, new untampered samples will be pushed onto g711steg.
+// - The code using this class will call minimumSamplesForPop() on g711steg.
+// - The code using this class will call capacities() (or bitsAvailableForEncode())
+//   on g711steg for the number of samples noted by minimumSamplesForPop(), getting a sum
+//   of bits available over the minimum allowed popped samples.
+// - The code using this class will call nextBit() a number of times equal to
+//   the sum mentioned in the last step.
+// - The code will pop the samples in question from g711steg.
+// - Repeat.
+
+// The implementation will always return bits intended for the next available
+// popped samples. Not adhering to the above will result in bits for the wrong
+// samples being returned.
+
+// The implementation will assume g711steg will not be deallocated while it
+// is being used. The implementation will not attempt to deallocate g711steg.
+
+// Provides the noisiest bits for each sample if worst, or the quietest
+// otherwise, for the bounds of the noise any payload could cause.
+
+// Algo may be G711StegAlgorithm, for any algorithm through the virtual
+// interface, or a concrete algorithm class for its calls to be bound
+// statically.
+template <class Algo, bool worst>
+class BasicNoiseBitProvider final : public BitProvider {
+	private:
+		Algo *g711steg;
+		steg_t hiddenData[SAMPLES_PER_PACKET];
+		length_t hiddenDataLength[SAMPLES_PER_PACKET];
+		length_t samples;
+		steg_t currentMask;
+		index_t currentSample, currentMaskIndex;
+	
+	public:
+		BasicNoiseBitProvider(Algo *g711steg) :
+			g711steg(g711steg), samples(0), currentMask(0),
+			currentSample(0), currentMaskIndex(0) {}
+		
+		length_t remainingBits() { return ~0; }
+		
+		bool nextBit();
+		
+		virtual ~BasicNoiseBitProvider() {}
+};
+
+template <class Algo>
+using BasicWorstNoiseBitProvider = BasicNoiseBitProvider<Algo, true>;
+template <class Algo>
+using BasicBestNoiseBitProvider = BasicNoiseBitProvider<Algo, false>;
+
+typedef BasicWorstNoiseBitProvider<G711StegAlgorithm> WorstNoiseBitProvider;
+typedef BasicBestNoiseBitProvider<G711StegAlgorithm> BestNoiseBitProvider;
+
+template <class Algo, bool worst>
+bool BasicNoiseBitProvider<Algo, worst>::nextBit() {
+	// Given the assumptions covered above for this class,
+	// we don't want to pre-emptively load in samples at the end
+	// of the method call. We must load in samples only when this
+	// method requires it at the last moment.
+	
+	// Consider if we tried pre-emptively loading samples:
+	// - g711steg is given samples by some code
+	// - this class obtains samples the first time this function is
+	//   called
+	// - some code calls this function the appropriate number of times
+	// - on the last call, we notice we gave out the last bit, and try
+	//   to load in more samples, but the code calling us and g711steg
+	//   hasn't given g711steg any additional samples yet, so we fail
+	
+	// As such, here we grab samples first and foremost if we need them,
+	// and do any cleanup we can aside from grabbing more samples at the
+	// end.
+	
+	if (! (currentSample < samples)) { // We're out of samples. Get the next set.
+		samples = g711steg->minimumSamplesForPop(); // Check that there actually are samples.
+		if (!samples) return false;
+		
+		g711steg->capacities(hiddenDataLength, samples);
+		for (index_t i = 0; i < samples; i++)
+			hiddenData[i] = worst ? g711steg->getNoisiestBitPattern(i) :
+				g711steg->getQuietestBitPattern(i);
+		
+		currentSample = 0;
+		currentMask = 1;
+		currentMaskIndex = 0;
+	}
+	
+	// At this point, either:
+	// - We just loaded the next set of samples (safe to continue)
+	//   -OR-
+	// - This is a repeat call to nextBit() on the same set of samples,
+	//   and because we'll clean up at the end (enough for the next call
+	//   to recognize if more samples are needed), safe to continue
+	
+	bool toReturn = false;
+	if (hiddenData[currentSample] & currentMask) toReturn = true;
+	
+	// Increment the mask/bit-index to be used next time.
+	currentMask <<= 1;
+	currentMaskIndex++;
+	
+	if (! (currentMaskIndex < hiddenDataLength[currentSample])) { // Out of bits for this sample?
+		// Move to the next sample. If there is no next sample
+		// (currentSample == samples), we'll take care of it
+		// on the next call.
+		currentSample++;
+		currentMask = 1;
+		currentMaskIndex = 0;
+	}
+	
+	return toReturn;
+}
+
+#endif
@@ -0,0 +1,82 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef NOISEPATTERNTABLE_HPP
+#define NOISEPATTERNTABLE_HPP
+
+#include "G711Sample.hpp"
+#include "StegAlgorithm.hpp"
+#include <cstdlib>
+
+#define NOISE_PATTERN_MAX_BITS 7
+
+// The noisiest and quietest patterns to hide in a sample, for algorithms
+// where those only depend on the transmitted byte and how many bits it can
+// carry. Filled in once from the algorithm's own tampering, so finding the
+// worst or best case costs a lookup per sample rather than tampering and
+// decoding each time.
+class NoisePatternTable {
+	private:
+		steg_t noisiestPatterns[2][NOISE_PATTERN_MAX_BITS + 1][256];
+		steg_t quietestPatterns[2][NOISE_PATTERN_MAX_BITS + 1][256];
+	
+	public:
+		// tamper(sample, bits, pattern) should return sample with the low
+		// bits of pattern hidden in it
+		template <class Tamper>
+		NoisePatternTable(Tamper tamper, length_t maxBits) {
+			for (int l = 0; l < 2; l++) {
+				bool law = l ? ULAW : ALAW;
+				
+				for (length_t bits = 0; bits <= NOISE_PATTERN_MAX_BITS; bits++) {
+					for (int in = 0; in < 256; in++) {
+						G711Sample sample(law, (g711Audio) in);
+						steg_t noisiest = 0, quietest = 0;
+						if ((bits > 0) && (bits <= maxBits)) {
+							// As getNoisiestExtremePatternOnly chooses: all 1s if
+							// that's noisier than all 0s, otherwise all 0s
+							linearAudio lowNoise = sample.linearDifference(tamper(sample, bits, 0));
+							linearAudio highNoise = sample.linearDifference(tamper(sample, bits, ~0));
+							if (abs(highNoise) > abs(lowNoise)) noisiest = ~0;
+							
+							// The first of the patterns with the least noise
+							linearAudio leastNoise = abs(lowNoise);
+							for (steg_t pattern = 1; pattern < ((steg_t) 1 << bits); pattern++) {
+								linearAudio thisNoise = abs(sample.linearDifference(tamper(sample, bits, pattern)));
+								if (thisNoise < leastNoise) {
+									leastNoise = thisNoise;
+									quietest = pattern;
+								}
+							}
+						}
+						noisiestPatterns[l][bits][in] = noisiest;
+						quietestPatterns[l][bits][in] = quietest;
+					}
+				}
+			}
+		}
+		
+		// bits must be no more than the maxBits the table was built for
+		steg_t noisiest(G711Sample sample, length_t bits) const {
+			return noisiestPatterns[sample.isUlaw() ? 1 : 0][bits][sample.transmissionSample()];
+		}
+		
+		steg_t quietest(G711Sample sample, length_t bits) const {
+			return quietestPatterns[sample.isUlaw() ? 1 : 0][bits][sample.transmissionSample()];
+		}
+};
+
+#endif
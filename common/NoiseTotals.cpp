@@ -0,0 +1,100 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef NOISETOTALS_CPP
+#define NOISETOTALS_CPP
+
+#include "NoiseTotals.hpp"
+#include <cmath>
+
+// Folds the upper half onto the lower until one value is left, so values
+// of like size are added together and each pass is a plain loop
+static double pairwiseSum(double *values, length_t count) {
+	if (!count) return 0;
+	
+	while (count > 1) {
+		length_t half = count / 2;
+		length_t kept = count - half;
+		double *__restrict lower = values;
+		const double *__restrict upper = values + kept;
+		for (index_t i = 0; i < half; i++)
+			lower[i] += upper[i];
+		count = kept;
+	}
+	
+	return values[0];
+}
+
+// Neumaier's variant of Kahan summation
+void NoiseTotals::addNSR(double value) {
+	double total = NSRsum + value;
+	if (fabs(NSRsum) >= fabs(value))
+		NSRcompensation += (NSRsum - total) + value;
+	else
+		NSRcompensation += (value - total) + NSRsum;
+	NSRsum = total;
+}
+
+// Each block is one pass filling arrays, then pairwise sums of them.
+// Energies are whole numbers too small to round (2^32 a sample at most)
+// so their sums are exact.
+void NoiseTotals::add(const linearAudio *original, const linearAudio *modified, length_t count) {
+	double signalSquared[NOISE_BLOCK_LENGTH], noiseSquared[NOISE_BLOCK_LENGTH], NSR[NOISE_BLOCK_LENGTH];
+	
+	while (count) {
+		length_t blockLength = (count < NOISE_BLOCK_LENGTH) ? count : NOISE_BLOCK_LENGTH;
+		length_t silentBlock = 0;
+		
+		// Silent samples are divided by one rather than zero, and their
+		// ratio then zeroed, so there's no branch
+		for (index_t i = 0; i < blockLength; i++) {
+			double signal = original[i];
+			double difference = original[i] - modified[i];
+			double silent = (original[i] == 0);
+			double ratio = difference / (signal + silent);
+			signalSquared[i] = signal * signal;
+			noiseSquared[i] = difference * difference;
+			NSR[i] = ratio * ratio * (1 - silent);
+			silentBlock += (original[i] == 0);
+		}
+		
+		signalEnergy += (unsigned long long) pairwiseSum(signalSquared, blockLength);
+		noiseEnergy += (unsigned long long) pairwiseSum(noiseSquared, blockLength);
+		silentSamples += silentBlock;
+		samples += blockLength;
+		addNSR(pairwiseSum(NSR, blockLength));
+		
+		original += blockLength;
+		modified += blockLength;
+		count -= blockLength;
+	}
+}
+
+void NoiseTotals::merge(const NoiseTotals &other) {
+	signalEnergy += other.signalEnergy;
+	noiseEnergy += other.noiseEnergy;
+	samples += other.samples;
+	silentSamples += other.silentSamples;
+	addNSR(other.NSRsum);
+	addNSR(other.NSRcompensation);
+}
+
+double NoiseTotals::meanNSR() const {
+	unsigned long long counted = samples - silentSamples;
+	return counted ? (NSRsum + NSRcompensation) / counted : 0;
+}
+
+#endif
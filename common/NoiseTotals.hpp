@@ -0,0 +1,65 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef NOISETOTALS_HPP
+#define NOISETOTALS_HPP
+
+#include "G711Sample.hpp"
+#include "StegAlgorithm.hpp"
+
+// Samples reduced at a time
+#define NOISE_BLOCK_LENGTH SAMPLES_PER_PACKET
+
+// Running totals of how much noise tampering added: noise and signal
+// energy, and the sum of each sample's noise-signal ratio for the mean.
+// Samples are added a block at a time from linear arrays, so each step is
+// a simple loop over the block. Energies are integers and kept exactly;
+// each block's ratios are summed pairwise, and the blocks' sums are added
+// with compensation, so the mean doesn't drift over hours of audio.
+// A sample with no signal has no ratio: it is counted, and its noise
+// goes into the energy, but it is left out of the mean.
+class NoiseTotals {
+	private:
+		unsigned long long signalEnergy, noiseEnergy;
+		unsigned long long samples, silentSamples;
+		double NSRsum, NSRcompensation;
+		
+		void addNSR(double value);
+		
+	public:
+		NoiseTotals() : signalEnergy(0), noiseEnergy(0), samples(0), silentSamples(0),
+			NSRsum(0), NSRcompensation(0) {}
+		
+		void add(const linearAudio *original, const linearAudio *modified, length_t count);
+		
+		// Add the totals for other samples
+		void merge(const NoiseTotals &other);
+		
+		unsigned long long signal() const { return signalEnergy; }
+		unsigned long long noise() const { return noiseEnergy; }
+		unsigned long long silent() const { return silentSamples; }
+		
+		// Mean of the per-sample noise-signal ratio over samples with signal
+		double meanNSR() const;
+		
+		// One sample's noise-signal ratio; original must not be silent
+		static double sampleNSR(linearAudio original, linearAudio modified) {
+			double ratio = 1.0 * (original - modified) / original;
+			return ratio * ratio;
+		}
+};
+
+#endif
@@ -0,0 +1,177 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PCAPFILE_CPP
+#define PCAPFILE_CPP
+
+#include "PcapFile.hpp"
+
+#define ETHERTYPE_IPV4 0x0800
+#define ETHERTYPE_IPV6 0x86DD
+#define ETHERTYPE_VLAN 0x8100
+#define IP_PROTOCOL_UDP 17
+#define UDP_HEADER_LENGTH 8
+
+static inline unsigned int big16(const unsigned char *data) {
+	return (data[0] << 8) | data[1];
+}
+
+static inline unsigned int big32(const unsigned char *data) {
+	return (big16(data) << 16) | big16(data + 2);
+}
+
+static inline unsigned int little32(const unsigned char *data) {
+	return data[0] | (data[1] << 8) | (data[2] << 16) | ((unsigned int) data[3] << 24);
+}
+
+PcapReader::PcapReader(const unsigned char *data, size_t size) :
+	data(data), size(size), position(PCAP_HEADER_LENGTH), swapped(false), linkType(0) {
+	if (!isPcap(data, size)) {
+		position = size;
+		return;
+	}
+	
+	unsigned int magic = little32(data);
+	swapped = (magic != PCAP_MAGIC) && (magic != PCAP_MAGIC_NANO);
+	linkType = header32(20) & 0xFFFF;
+}
+
+bool PcapReader::isPcap(const unsigned char *data, size_t size) {
+	if (size < PCAP_HEADER_LENGTH) return false;
+	unsigned int little = little32(data), big = big32(data);
+	return (little == PCAP_MAGIC) || (little == PCAP_MAGIC_NANO) ||
+		(big == PCAP_MAGIC) || (big == PCAP_MAGIC_NANO);
+}
+
+unsigned int PcapReader::header32(size_t offset) const {
+	return swapped ? big32(data + offset) : little32(data + offset);
+}
+
+bool PcapReader::isSupported() const {
+	return (linkType == PCAP_LINKTYPE_ETHERNET) || (linkType == PCAP_LINKTYPE_RAW) ||
+		(linkType == PCAP_LINKTYPE_LINUX_SLL) || (linkType == PCAP_LINKTYPE_IPV4) ||
+		(linkType == PCAP_LINKTYPE_IPV6);
+}
+
+bool PcapReader::next(size_t *recordStart, size_t *recordLength, rtpPacket *packet, bool *isRtp) {
+	if (position + PCAP_RECORD_HEADER_LENGTH > size) return false;
+	
+	size_t captured = header32(position + 8);
+	size_t original = header32(position + 12);
+	if (position + PCAP_RECORD_HEADER_LENGTH + captured > size) return false;
+	
+	*recordStart = position;
+	*recordLength = PCAP_RECORD_HEADER_LENGTH + captured;
+	*isRtp = (captured == original) && isSupported() &&
+		findRtp(position + PCAP_RECORD_HEADER_LENGTH, captured, packet);
+	
+	position += *recordLength;
+	return true;
+}
+
+bool PcapReader::findRtp(size_t start, size_t length, rtpPacket *packet) const {
+	const unsigned char *frame = data + start;
+	size_t offset = 0;
+	unsigned int etherType = 0;
+	
+	// Link layer
+	if (linkType == PCAP_LINKTYPE_ETHERNET) {
+		if (length < 14) return false;
+		etherType = big16(frame + 12);
+		offset = 14;
+		while ((etherType == ETHERTYPE_VLAN) && (offset + 4 <= length)) {
+			etherType = big16(frame + offset + 2);
+			offset += 4;
+		}
+	} else if (linkType == PCAP_LINKTYPE_LINUX_SLL) {
+		if (length < 16) return false;
+		etherType = big16(frame + 14);
+		offset = 16;
+	} else {
+		if (length < 1) return false;
+		etherType = ((frame[0] >> 4) == 6) ? ETHERTYPE_IPV6 : ETHERTYPE_IPV4;
+	}
+	
+	// Network layer
+	size_t ip = offset, udp;
+	if (etherType == ETHERTYPE_IPV4) {
+		if ((ip + 20 > length) || ((frame[ip] >> 4) != 4)) return false;
+		size_t headerLength = (frame[ip] & 0x0F) * 4;
+		if ((headerLength < 20) || (frame[ip + 9] != IP_PROTOCOL_UDP)) return false;
+		if (big16(frame + ip + 6) & 0x3FFF) return false; // More fragments, or a fragment offset
+		packet->ipVersion = 4;
+		udp = ip + headerLength;
+	} else if (etherType == ETHERTYPE_IPV6) {
+		if ((ip + 40 > length) || ((frame[ip] >> 4) != 6)) return false;
+		if (frame[ip + 6] != IP_PROTOCOL_UDP) return false; // Extension headers aren't followed
+		packet->ipVersion = 6;
+		udp = ip + 40;
+	} else {
+		return false;
+	}
+	
+	// Transport layer
+	if (udp + UDP_HEADER_LENGTH > length) return false;
+	size_t udpLength = big16(frame + udp + 4);
+	if ((udpLength < UDP_HEADER_LENGTH) || (udp + udpLength > length)) return false;
+	
+	rtpHeader rtp;
+	if (!parseG711Rtp(frame + udp + UDP_HEADER_LENGTH, udpLength - UDP_HEADER_LENGTH, &rtp)) return false;
+	
+	packet->ip = start + ip;
+	packet->udp = start + udp;
+	packet->payload = start + udp + UDP_HEADER_LENGTH + rtp.headerLength;
+	packet->payloadLength = rtp.payloadLength;
+	packet->payloadType = rtp.payloadType;
+	packet->ssrc = rtp.ssrc;
+	return true;
+}
+
+void PcapReader::fixChecksum(unsigned char *capture, const rtpPacket &packet) {
+	unsigned char *ip = capture + packet.ip, *udp = capture + packet.udp;
+	size_t udpLength = big16(udp + 4);
+	unsigned long sum = 0;
+	
+	// Only IPv4 makes the checksum optional
+	if ((packet.ipVersion == 4) && (!big16(udp + 6))) return;
+	
+	// Pseudo-header: addresses, protocol and UDP length
+	if (packet.ipVersion == 4) {
+		for (index_t i = 12; i < 20; i += 2)
+			sum += big16(ip + i);
+	} else {
+		for (index_t i = 8; i < 40; i += 2)
+			sum += big16(ip + i);
+	}
+	sum += IP_PROTOCOL_UDP + udpLength;
+	
+	udp[6] = udp[7] = 0;
+	for (size_t i = 0; i + 1 < udpLength; i += 2)
+		sum += big16(udp + i);
+	if (udpLength & 1)
+		sum += udp[udpLength - 1] << 8;
+	
+	while (sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	unsigned int checksum = (~sum) & 0xFFFF;
+	if (!checksum) checksum = 0xFFFF;
+	
+	udp[6] = checksum >> 8;
+	udp[7] = checksum & 0xFF;
+}
+
+#endif
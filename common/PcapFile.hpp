@@ -0,0 +1,76 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef PCAPFILE_HPP
+#define PCAPFILE_HPP
+
+#include "StegAlgorithm.hpp"
+#include "RtpHeader.hpp"
+#include <cstddef>
+
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_MAGIC_NANO 0xa1b23c4d
+#define PCAP_HEADER_LENGTH 24
+#define PCAP_RECORD_HEADER_LENGTH 16
+
+#define PCAP_LINKTYPE_ETHERNET 1
+#define PCAP_LINKTYPE_RAW 101
+#define PCAP_LINKTYPE_LINUX_SLL 113
+#define PCAP_LINKTYPE_IPV4 228
+#define PCAP_LINKTYPE_IPV6 229
+
+// Where an RTP packet carrying G711 is in a capture. Offsets are from the
+// start of the file, so are as good for a rewritten copy of it.
+typedef struct rtpPacketS {
+	size_t ip, udp, payload;
+	length_t payloadLength;
+	unsigned char ipVersion;
+	unsigned char payloadType;
+	unsigned int ssrc;
+} rtpPacket;
+
+// Walks the records of a classic (not pcapng) capture in memory, picking out
+// UDP packets over IPv4 or IPv6 that look like RTP with a PCMU or PCMA payload.
+// Fragmented and truncated packets are passed over.
+class PcapReader {
+	private:
+		const unsigned char *data;
+		size_t size, position;
+		bool swapped;
+		unsigned int linkType;
+		
+		unsigned int header32(size_t offset) const;
+		bool findRtp(size_t start, size_t length, rtpPacket *packet) const;
+		
+	public:
+		PcapReader(const unsigned char *data, size_t size);
+		
+		static bool isPcap(const unsigned char *data, size_t size);
+		
+		// False if the link type isn't one understood
+		bool isSupported() const;
+		
+		// Moves to the next record, giving where it is (header included).
+		// isRtp says whether packet was filled in. False at the end.
+		bool next(size_t *recordStart, size_t *recordLength, rtpPacket *packet, bool *isRtp);
+		
+		// Recompute the UDP checksum of a packet in a copy of the capture,
+		// after its payload has changed. IPv4 packets sent without one stay so.
+		static void fixChecksum(unsigned char *capture, const rtpPacket &packet);
+};
+
+#endif
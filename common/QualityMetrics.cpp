@@ -0,0 +1,190 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QUALITYMETRICS_CPP
+#define QUALITYMETRICS_CPP
+
+#include "QualityMetrics.hpp"
+#include <algorithm>
+#include <cmath>
+
+QualityMetrics::QualityMetrics() : frameFill(0), SNRsum(0), LSDsum(0), frames(0) {
+	for (index_t i = 0; i < QUALITY_FRAME_LENGTH; i++)
+		window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / (QUALITY_FRAME_LENGTH - 1));
+	
+	for (index_t i = 0; i < QUALITY_FFT_LENGTH / 2; i++) {
+		twiddleRe[i] = cos(-2 * M_PI * i / QUALITY_FFT_LENGTH);
+		twiddleIm[i] = sin(-2 * M_PI * i / QUALITY_FFT_LENGTH);
+	}
+	
+	for (index_t i = 0; i < QUALITY_FFT_LENGTH; i++) {
+		reversed[i] = 0;
+		for (index_t bit = 0; bit < QUALITY_FFT_BITS; bit++)
+			if (i & (1 << bit)) reversed[i] |= 1 << (QUALITY_FFT_BITS - 1 - bit);
+	}
+}
+
+// Both frames go through one complex FFT - original as the real part and
+// modified as the imaginary part - and are separated afterwards using the
+// symmetry of a real signal's spectrum.
+double QualityMetrics::spectralDistance(length_t count) {
+	double re[QUALITY_FFT_LENGTH], im[QUALITY_FFT_LENGTH];
+	
+	for (index_t i = 0; i < QUALITY_FFT_LENGTH; i++) {
+		index_t from = reversed[i];
+		if (from < count) {
+			re[i] = frameOriginal[from] * window[from];
+			im[i] = frameModified[from] * window[from];
+		} else {
+			re[i] = 0;
+			im[i] = 0;
+		}
+	}
+	
+	// Radix-2 butterflies; the inner loop runs over contiguous arrays
+	// so the compiler can vectorise it
+	for (length_t length = 2; length <= QUALITY_FFT_LENGTH; length <<= 1) {
+		length_t half = length / 2, step = QUALITY_FFT_LENGTH / length;
+		for (index_t start = 0; start < QUALITY_FFT_LENGTH; start += length) {
+			double *aRe = re + start, *aIm = im + start;
+			double *bRe = aRe + half, *bIm = aIm + half;
+			for (index_t j = 0; j < half; j++) {
+				double wRe = twiddleRe[j * step], wIm = twiddleIm[j * step];
+				double tRe = bRe[j] * wRe - bIm[j] * wIm;
+				double tIm = bRe[j] * wIm + bIm[j] * wRe;
+				bRe[j] = aRe[j] - tRe;
+				bIm[j] = aIm[j] - tIm;
+				aRe[j] += tRe;
+				aIm[j] += tIm;
+			}
+		}
+	}
+	
+	double sum = 0;
+	for (index_t k = 0; k <= QUALITY_FFT_LENGTH / 2; k++) {
+		index_t n = (QUALITY_FFT_LENGTH - k) % QUALITY_FFT_LENGTH;
+		double sumRe = re[k] + re[n], diffRe = re[k] - re[n];
+		double sumIm = im[k] + im[n], diffIm = im[k] - im[n];
+		
+		// Four times each power - the scale cancels in the ratio
+		// Plus a floor of one so silent bins don't blow up the log
+		double powerOriginal = sumRe * sumRe + diffIm * diffIm + 4;
+		double powerModified = sumIm * sumIm + diffRe * diffRe + 4;
+		double distance = 10 * log10(powerOriginal / powerModified);
+		sum += distance * distance;
+	}
+	
+	return sqrt(sum / (QUALITY_FFT_LENGTH / 2 + 1));
+}
+
+void QualityMetrics::processFrame() {
+	totals.add(frameOriginal, frameModified, frameFill);
+	
+	double signal = 0, noise = 0;
+	for (index_t i = 0; i < frameFill; i++) {
+		double original = frameOriginal[i];
+		double difference = original - frameModified[i];
+		signal += original * original;
+		noise += difference * difference;
+	}
+	
+	if (signal > 0) {
+		double SNR = QUALITY_SNR_CEILING;
+		if (noise > 0) {
+			SNR = 10 * log10(signal / noise);
+			if (SNR < QUALITY_SNR_FLOOR) SNR = QUALITY_SNR_FLOOR;
+			if (SNR > QUALITY_SNR_CEILING) SNR = QUALITY_SNR_CEILING;
+		}
+		
+		SNRsum += SNR;
+		LSDsum += spectralDistance(frameFill);
+		packetNSR.push_back(noise / signal);
+		frames++;
+	}
+	
+	frameFill = 0;
+}
+
+void QualityMetrics::add(const linearAudio *original, const linearAudio *modified, length_t count) {
+	while (count) {
+		length_t run = QUALITY_FRAME_LENGTH - frameFill;
+		if (run > count) run = count;
+		for (index_t i = 0; i < run; i++) {
+			frameOriginal[frameFill + i] = original[i];
+			frameModified[frameFill + i] = modified[i];
+		}
+		
+		frameFill += run;
+		if (frameFill == QUALITY_FRAME_LENGTH) processFrame();
+		original += run;
+		modified += run;
+		count -= run;
+	}
+}
+
+void QualityMetrics::merge(const QualityMetrics &following) {
+	SNRsum += following.SNRsum;
+	LSDsum += following.LSDsum;
+	frames += following.frames;
+	packetNSR.insert(packetNSR.end(), following.packetNSR.begin(), following.packetNSR.end());
+	totals.merge(following.totals);
+}
+
+// Clamped as for a frame
+double QualityMetrics::globalSNR() const {
+	if (!totals.signal()) return 0;
+	if (!totals.noise()) return QUALITY_SNR_CEILING;
+	
+	double SNR = 10 * log10(1.0 * totals.signal() / totals.noise());
+	if (SNR < QUALITY_SNR_FLOOR) SNR = QUALITY_SNR_FLOOR;
+	if (SNR > QUALITY_SNR_CEILING) SNR = QUALITY_SNR_CEILING;
+	return SNR;
+}
+
+double QualityMetrics::segmentalSNR() const {
+	return frames ? SNRsum / frames : 0;
+}
+
+double QualityMetrics::logSpectralDistance() const {
+	return frames ? LSDsum / frames : 0;
+}
+
+// Nearest rank
+double QualityMetrics::packetNSRPercentile(double percent) const {
+	if (packetNSR.empty()) return 0;
+	
+	std::vector<double> sorted(packetNSR);
+	std::sort(sorted.begin(), sorted.end());
+	
+	index_t rank = (index_t) ceil(percent / 100 * sorted.size());
+	if (rank > 0) rank--;
+	if (rank >= sorted.size()) rank = sorted.size() - 1;
+	return sorted[rank];
+}
+
+void QualityMetrics::write(std::ostream *out) const {
+	*out << std::fixed;
+	*out << "Global SNR dB:\t" << globalSNR() << std::endl;
+	*out << "Segmental SNR dB:\t" << segmentalSNR() << std::endl;
+	*out << "Log-spectral distance dB:\t" << logSpectralDistance() << std::endl;
+	*out << "Packet noise-signal ratio median:\t" << packetNSRPercentile(50) << std::endl;
+	*out << "Packet noise-signal ratio 95th percentile:\t" << packetNSRPercentile(95) << std::endl;
+	*out << "Packet noise-signal ratio maximum:\t" << packetNSRPercentile(100) << std::endl;
+	*out << "Samples without signal:\t" << totals.silent() << std::endl;
+}
+
+#endif
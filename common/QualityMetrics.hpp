@@ -0,0 +1,93 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef QUALITYMETRICS_HPP
+#define QUALITYMETRICS_HPP
+
+#include "G711Sample.hpp"
+#include "StegAlgorithm.hpp"
+#include "NoiseTotals.hpp"
+#include <ostream>
+#include <vector>
+
+// 20ms frames, as packets are
+#define QUALITY_FRAME_LENGTH SAMPLES_PER_PACKET
+// Frames are windowed and zero-padded up to this for the FFT
+#define QUALITY_FFT_LENGTH 256
+#define QUALITY_FFT_BITS 8
+// Per-frame segmental SNR is clamped to this range, in dB
+#define QUALITY_SNR_FLOOR -10.0
+#define QUALITY_SNR_CEILING 35.0
+
+// Objective quality of a stego carrier against its original, computed
+// while embedding so a sweep needn't convert everything for PESQ:
+// segmental SNR and log-spectral distance over 20ms frames, and
+// percentiles of each packet's noise-signal ratio (noise energy over
+// signal energy). Frames with no signal are left out of all three.
+// Every frame also goes into the totals for the mean noise-signal ratio
+// and the SNR over the whole carrier.
+class QualityMetrics {
+	private:
+		// The frame being collected
+		linearAudio frameOriginal[QUALITY_FRAME_LENGTH], frameModified[QUALITY_FRAME_LENGTH];
+		length_t frameFill;
+		
+		// FFT tables: window, twiddles and bit reversal
+		double window[QUALITY_FRAME_LENGTH];
+		double twiddleRe[QUALITY_FFT_LENGTH / 2], twiddleIm[QUALITY_FFT_LENGTH / 2];
+		unsigned short reversed[QUALITY_FFT_LENGTH];
+		
+		double SNRsum, LSDsum;
+		length_t frames;
+		std::vector<double> packetNSR;
+		NoiseTotals totals;
+		
+		void processFrame();
+		double spectralDistance(length_t count);
+		
+	public:
+		QualityMetrics();
+		
+		void add(const G711Sample &original, const G711Sample &modified) {
+			frameOriginal[frameFill] = original.linearSample();
+			frameModified[frameFill] = modified.linearSample();
+			if (++frameFill == QUALITY_FRAME_LENGTH) processFrame();
+		}
+		
+		// As above, for count samples already converted to linear
+		void add(const linearAudio *original, const linearAudio *modified, length_t count);
+		
+		// Include a final partial frame
+		void finish() { if (frameFill) processFrame(); }
+		
+		// Add the frames of metrics for the samples following these;
+		// these must not have a partial frame
+		void merge(const QualityMetrics &following);
+		
+		// Only complete once finished
+		const NoiseTotals& noise() const { return totals; }
+		double meanNSR() const { return totals.meanNSR(); }
+		double globalSNR() const;
+		double segmentalSNR() const;
+		double logSpectralDistance() const;
+		double packetNSRPercentile(double percent) const;
+		
+		// Summary file lines
+		void write(std::ostream *out) const;
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef RANDOMBITPROVIDER_HPP
+#define RANDOMBITPROVIDER_HPP
+
+#include "BitProvider.hpp"
+
+// Uniformly random bits from xoshiro256**, 64 per step, for the noise an
+// average (encrypted or compressed) payload would cause. The same seed
+// always gives the same bits, and there's no end to them.
+class RandomBitProvider final : public BitProvider {
+	private:
+		unsigned long long state[4];
+		unsigned long long word;
+		unsigned int wordBits;
+		
+		static unsigned long long rotate(unsigned long long x, int k) {
+			return (x << k) | (x >> (64 - k));
+		}
+		
+		unsigned long long next() {
+			unsigned long long result = rotate(state[1] * 5, 7) * 9;
+			unsigned long long t = state[1] << 17;
+			state[2] ^= state[0];
+			state[3] ^= state[1];
+			state[1] ^= state[2];
+			state[0] ^= state[3];
+			state[2] ^= t;
+			state[3] = rotate(state[3], 45);
+			return result;
+		}
+	
+	public:
+		RandomBitProvider(unsigned long long seed) : word(0), wordBits(0) {
+			// Spread the seed over the whole state with splitmix64, which
+			// can't leave it all zero
+			for (int i = 0; i < 4; i++) {
+				unsigned long long z = (seed += 0x9E3779B97F4A7C15ULL);
+				z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+				z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+				state[i] = z ^ (z >> 31);
+			}
+		}
+		
+		length_t remainingBits() { return ~0; }
+		
+		bool nextBit() {
+			if (!wordBits) {
+				word = next();
+				wordBits = 64;
+			}
+			
+			bool toReturn = word & 1;
+			word >>= 1;
+			wordBits--;
+			return toReturn;
+		}
+		
+		unsigned long long nextBits(unsigned int count) {
+			if (count <= wordBits) {
+				unsigned long long bits = (count < 64) ? (word & ((1ULL << count) - 1)) : word;
+				word = (count < 64) ? (word >> count) : 0;
+				wordBits -= count;
+				return bits;
+			}
+			
+			// What's left of this word, then the rest from the next
+			unsigned long long bits = word;
+			unsigned int have = wordBits, need = count - wordBits;
+			word = next();
+			bits |= ((need < 64) ? (word & ((1ULL << need) - 1)) : word) << have;
+			word = (need < 64) ? (word >> need) : 0;
+			wordBits = 64 - need;
+			return bits;
+		}
+		
+		virtual ~RandomBitProvider() {}
+};
+
+#endif
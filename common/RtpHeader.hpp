@@ -0,0 +1,59 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RTPHEADER_HPP
+#define RTPHEADER_HPP
+
+#include "StegAlgorithm.hpp"
+#include <cstddef>
+
+#define RTP_HEADER_LENGTH 12
+#define RTP_PAYLOAD_PCMU 0
+#define RTP_PAYLOAD_PCMA 8
+
+// The parts of an RTP header needed to find a G711 payload
+typedef struct rtpHeaderS {
+	length_t headerLength, payloadLength;
+	unsigned char payloadType;
+	unsigned int ssrc;
+} rtpHeader;
+
+// Parses the RTP packet at the start of a UDP payload, accepting only
+// version 2 with a PCMU or PCMA payload of at least one sample. CSRCs,
+// an extension and padding are stepped over.
+inline bool parseG711Rtp(const unsigned char *rtp, size_t length, rtpHeader *header) {
+	if (length < RTP_HEADER_LENGTH) return false;
+	if ((rtp[0] >> 6) != 2) return false;
+	
+	header->payloadType = rtp[1] & 0x7F;
+	if ((header->payloadType != RTP_PAYLOAD_PCMU) && (header->payloadType != RTP_PAYLOAD_PCMA)) return false;
+	
+	size_t headerLength = RTP_HEADER_LENGTH + 4 * (rtp[0] & 0x0F);
+	if (rtp[0] & 0x10) { // Extension
+		if (headerLength + 4 > length) return false;
+		headerLength += 4 + 4 * ((rtp[headerLength + 2] << 8) | rtp[headerLength + 3]);
+	}
+	size_t padding = (rtp[0] & 0x20) ? rtp[length - 1] : 0;
+	if (headerLength + padding >= length) return false;
+	
+	header->headerLength = headerLength;
+	header->payloadLength = length - headerLength - padding;
+	header->ssrc = ((unsigned int) rtp[8] << 24) | (rtp[9] << 16) | (rtp[10] << 8) | rtp[11];
+	return true;
+}
+
+#endif
@@ -0,0 +1,486 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RTPPROXY_CPP
+#define RTPPROXY_CPP
+
+#include "RtpProxy.hpp"
+#include "FileBitProvider.hpp"
+#include "NoiseBitProvider.hpp"
+#include "BitPacker.hpp"
+#include <sys/epoll.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <signal.h>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <cerrno>
+#include <cmath>
+
+#define PROXY_RECEIVE_BUFFER (4 * 1024 * 1024)
+
+static volatile sig_atomic_t proxyInterrupted = 0;
+
+static void onProxyInterrupt(int) {
+	proxyInterrupted = 1;
+}
+
+bool RtpProxy::parseAddress(const char *text, struct sockaddr_in *address, unsigned int *ports) {
+	const char *colon = strrchr(text, ':');
+	if (!colon) return false;
+	
+	std::string host(text, colon - text);
+	memset(address, 0, sizeof(*address));
+	address->sin_family = AF_INET;
+	if (inet_pton(AF_INET, host.c_str(), &address->sin_addr) != 1) return false;
+	
+	char *end;
+	unsigned long first = strtoul(colon + 1, &end, 10), last = first;
+	if (*end == '-') last = strtoul(end + 1, &end, 10);
+	if (*end || (!first) || (last < first) || (last > 65535) || (last - first + 1 > PROXY_MAX_PORTS))
+		return false;
+	
+	address->sin_port = htons(first);
+	*ports = last - first + 1;
+	return true;
+}
+
+RtpProxy::RtpProxy(G711StegAlgorithm *prototype, algorithmCopier copier, bool isReceiver,
+	char *embedFile, const char *extractPrefix, double verifyFraction, bool statistics,
+	double idleSeconds) :
+		prototype(prototype), copier(copier), isReceiver(isReceiver), embedFile(embedFile),
+		extractPrefix(extractPrefix), verifyFraction(verifyFraction), statistics(statistics),
+		idleSeconds(idleSeconds),
+		failed(false), processedSamples(0), processedPackets(0), passedPackets(0),
+		processedHiddenBits(0) {}
+
+bool RtpProxy::open(const char *listen, const char *destination) {
+	struct sockaddr_in listenAddress, destinationAddress;
+	unsigned int listenPorts, destinationPorts = 0;
+	
+	if (!parseAddress(listen, &listenAddress, &listenPorts)) {
+		std::cout << "[RtpProxy] Couldn't understand address " << listen << std::endl;
+		return false;
+	}
+	if (destination && ((!parseAddress(destination, &destinationAddress, &destinationPorts)) ||
+		((destinationPorts != 1) && (destinationPorts != listenPorts)))) {
+			std::cout << "[RtpProxy] Couldn't understand address " << destination
+				<< " - give one port, or as many as are listened on" << std::endl;
+			return false;
+		}
+	
+	for (index_t i = 0; i < listenPorts; i++) {
+		struct sockaddr_in address = listenAddress;
+		address.sin_port = htons(ntohs(listenAddress.sin_port) + i);
+		
+		int fd = socket(AF_INET, SOCK_DGRAM, 0);
+		int size = PROXY_RECEIVE_BUFFER, yes = 1;
+		if (fd >= 0) {
+			setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+			setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		}
+		if ((fd < 0) || (bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0)) {
+			std::cout << "[RtpProxy] Couldn't listen on port " << ntohs(address.sin_port)
+				<< ": " << strerror(errno) << std::endl;
+			if (fd >= 0) close(fd);
+			return false;
+		}
+		sockets.push_back(fd);
+		
+		if (destination) {
+			struct sockaddr_in to = destinationAddress;
+			if (destinationPorts > 1)
+				to.sin_port = htons(ntohs(destinationAddress.sin_port) + i);
+			destinations.push_back(to);
+		}
+	}
+	ready.resize(sockets.size());
+	
+	std::cout << "[RtpProxy] Listening on " << listen;
+	if (destination) std::cout << ", sending on to " << destination;
+	std::cout << std::endl;
+	return true;
+}
+
+proxyPacket* RtpProxy::newPacket() {
+	if (freePackets.empty()) return new proxyPacket;
+	proxyPacket *packet = freePackets.back();
+	freePackets.pop_back();
+	return packet;
+}
+
+proxyStream* RtpProxy::newStream(unsigned int ssrc, bool law) {
+	proxyStream *stream = new proxyStream;
+	stream->ssrc = ssrc;
+	stream->law = law;
+	stream->algorithm = copier(prototype);
+	
+	stream->bitSource = NULL;
+	stream->embedder = NULL;
+	stream->isDone = false;
+	if (!isReceiver) {
+		if (embedFile)
+			stream->bitSource = new FileBitProvider(embedFile);
+		else
+			stream->bitSource = new WorstNoiseBitProvider(stream->algorithm);
+		stream->embedder = new StreamEmbedder(stream->algorithm, stream->bitSource, verifyFraction, statistics);
+	}
+	
+	stream->extracted = NULL;
+	stream->assembler = NULL;
+	if (isReceiver) {
+		char suffix[16];
+		sprintf(suffix, ".%08x", ssrc);
+		stream->extractedFile = std::string(extractPrefix) + suffix;
+		stream->extracted = new std::ofstream(stream->extractedFile.c_str(), std::ios::out | std::ios::binary);
+		stream->assembler = new BitAssembler(stream->extracted);
+	}
+	
+	stream->packets = stream->samples = 0;
+	stream->bits = 0;
+	
+	bySsrc[ssrc] = stream;
+	streams.push_back(stream);
+	return stream;
+}
+
+// Done with a packet - sent, or extracted from
+void RtpProxy::finish(proxyPacket *packet) {
+	if (packet->payloadLength) {
+		std::chrono::duration<double, std::micro> spent = proxyClock::now() - packet->received;
+		latencies.push_back(spent.count());
+	}
+	freePackets.push_back(packet);
+}
+
+void RtpProxy::handlePacket(proxyPacket *packet, const proxyClock::time_point &now) {
+	rtpHeader rtp;
+	packet->payloadLength = 0;
+	if (!parseG711Rtp(packet->data, packet->length, &rtp)) {
+		// Not ours to touch
+		passedPackets++;
+		if (isReceiver) finish(packet);
+		else ready[packet->socket].push_back(packet);
+		return;
+	}
+	
+	bool law = (rtp.payloadType == RTP_PAYLOAD_PCMU) ? ULAW : ALAW;
+	std::map<unsigned int, proxyStream*>::iterator found = bySsrc.find(rtp.ssrc);
+	proxyStream *stream = (found == bySsrc.end()) ? newStream(rtp.ssrc, law) : found->second;
+	stream->lastSeen = now;
+	
+	// A stream changing law part way through only keeps its first
+	if (stream->law != law) {
+		passedPackets++;
+		if (isReceiver) finish(packet);
+		else ready[packet->socket].push_back(packet);
+		return;
+	}
+	
+	stream->packets++;
+	processedPackets++;
+	packet->payload = rtp.headerLength;
+	packet->payloadLength = rtp.payloadLength;
+	packet->written = 0;
+	
+	if (isReceiver) {
+		extractPacket(stream, packet);
+		finish(packet);
+	} else if (stream->isDone) {
+		ready[packet->socket].push_back(packet);
+	} else if (!embedPacket(stream, packet)) {
+		failed = true;
+	}
+}
+
+// Send on whatever a stream is holding, as it is
+void RtpProxy::releasePending(proxyStream *stream) {
+	while (!stream->pending.empty()) {
+		proxyPacket *packet = stream->pending.front();
+		stream->pending.pop_front();
+		ready[packet->socket].push_back(packet);
+	}
+}
+
+// As RtpStreams does, but sending packets on as they're completed
+bool RtpProxy::embedPacket(proxyStream *stream, proxyPacket *packet) {
+	G711Sample samples[SAMPLES_PER_PACKET];
+	stream->pending.push_back(packet);
+	
+	for (index_t start = 0; (start < packet->payloadLength) && (!stream->isDone); start += SAMPLES_PER_PACKET) {
+		length_t count = packet->payloadLength - start;
+		if (count > SAMPLES_PER_PACKET) count = SAMPLES_PER_PACKET;
+		
+		for (index_t i = 0; i < count; i++)
+			samples[i] = G711Sample(stream->law, packet->data[packet->payload + start + i]);
+		
+		stream->tampered.clear();
+		if (!stream->embedder->embed(samples, count, &stream->tampered)) {
+			std::cout << "[RtpProxy] Stream " << std::hex << stream->ssrc << std::dec << " failed verification" << std::endl;
+			return false;
+		}
+		
+		// Samples only come back for packets still pending
+		for (index_t i = 0; (i < stream->tampered.size()) && (!stream->pending.empty()); i++) {
+			proxyPacket *front = stream->pending.front();
+			front->data[front->payload + front->written] = stream->tampered[i].transmissionSample();
+			if (++front->written == front->payloadLength) {
+				stream->pending.pop_front();
+				ready[front->socket].push_back(front);
+			}
+		}
+		
+		// Nothing more will be tampered with, so nothing more is held back
+		if (stream->embedder->isDone()) {
+			stream->isDone = true;
+			releasePending(stream);
+		}
+	}
+	
+	return true;
+}
+
+// As RtpStreams does
+void RtpProxy::extractPacket(proxyStream *stream, proxyPacket *packet) {
+	G711StegAlgorithm *algorithm = stream->algorithm;
+	G711Sample samples[SAMPLES_PER_PACKET];
+	steg_t hiddenData[SAMPLES_PER_PACKET];
+	length_t hiddenDataLength[SAMPLES_PER_PACKET];
+	int state[SAMPLES_PER_PACKET];
+	
+	for (index_t start = 0; start < packet->payloadLength; start += SAMPLES_PER_PACKET) {
+		length_t count = packet->payloadLength - start;
+		if (count > SAMPLES_PER_PACKET) count = SAMPLES_PER_PACKET;
+		
+		for (index_t i = 0; i < count; i++)
+			samples[i] = G711Sample(stream->law, packet->data[packet->payload + start + i]);
+		algorithm->pushTamperedSamples(samples, count);
+		
+		length_t sampleCount;
+		while ((sampleCount = algorithm->recoveredDataReadyForPop())) {
+			if (sampleCount > SAMPLES_PER_PACKET) sampleCount = SAMPLES_PER_PACKET;
+			sampleCount = algorithm->popRecoveredData(hiddenData, hiddenDataLength, state, sampleCount);
+			if (!sampleCount) break;
+			
+			stream->samples += sampleCount;
+			gatherBits(hiddenData, hiddenDataLength, sampleCount,
+				[&](unsigned long long bits, length_t bitCount) {
+					stream->bits += bitCount;
+					stream->assembler->append(bits, bitCount);
+				});
+		}
+	}
+}
+
+void RtpProxy::sendReady() {
+	struct mmsghdr messages[PROXY_BATCH];
+	struct iovec vectors[PROXY_BATCH];
+	
+	for (index_t s = 0; s < sockets.size(); s++) {
+		std::vector<proxyPacket*> &toSend = ready[s];
+		
+		for (index_t first = 0; first < toSend.size(); ) {
+			length_t count = toSend.size() - first;
+			if (count > PROXY_BATCH) count = PROXY_BATCH;
+			
+			memset(messages, 0, sizeof(messages[0]) * count);
+			for (index_t i = 0; i < count; i++) {
+				vectors[i].iov_base = toSend[first + i]->data;
+				vectors[i].iov_len = toSend[first + i]->length;
+				messages[i].msg_hdr.msg_iov = &vectors[i];
+				messages[i].msg_hdr.msg_iovlen = 1;
+				messages[i].msg_hdr.msg_name = &destinations[s];
+				messages[i].msg_hdr.msg_namelen = sizeof(destinations[s]);
+			}
+			
+			int sent = sendmmsg(sockets[s], messages, count, 0);
+			if (sent <= 0) {
+				if ((sent < 0) && (errno == EINTR)) continue;
+				// Dropped, as the network might have
+				std::cout << "[RtpProxy] Couldn't send: " << strerror(errno) << std::endl;
+				sent = 1;
+			}
+			
+			for (index_t i = 0; i < (index_t) sent; i++)
+				finish(toSend[first + i]);
+			first += sent;
+		}
+		
+		toSend.clear();
+	}
+}
+
+bool RtpProxy::run() {
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = onProxyInterrupt;
+	sigaction(SIGINT, &action, NULL);
+	sigaction(SIGTERM, &action, NULL);
+	
+	int poller = epoll_create1(0);
+	for (index_t s = 0; s < sockets.size(); s++) {
+		struct epoll_event event;
+		event.events = EPOLLIN;
+		event.data.u32 = s;
+		epoll_ctl(poller, EPOLL_CTL_ADD, sockets[s], &event);
+	}
+	
+	struct mmsghdr messages[PROXY_BATCH];
+	struct iovec vectors[PROXY_BATCH];
+	proxyPacket *batch[PROXY_BATCH];
+	struct epoll_event events[PROXY_BATCH];
+	proxyClock::time_point now = proxyClock::now(), lastPacket = now;
+	
+	while ((!proxyInterrupted) && (!failed)) {
+		int socketsReady = epoll_wait(poller, events, PROXY_BATCH, PROXY_STREAM_IDLE_MS / 4);
+		if ((socketsReady < 0) && (errno != EINTR)) break;
+		
+		for (int e = 0; (e < socketsReady) && (!failed); e++) {
+			index_t s = events[e].data.u32;
+			int got;
+			
+			// Take everything waiting, a batch at a time
+			do {
+				for (index_t b = 0; b < PROXY_BATCH; b++) {
+					batch[b] = newPacket();
+					vectors[b].iov_base = batch[b]->data;
+					vectors[b].iov_len = PROXY_PACKET_LENGTH;
+					memset(&messages[b], 0, sizeof(messages[b]));
+					messages[b].msg_hdr.msg_iov = &vectors[b];
+					messages[b].msg_hdr.msg_iovlen = 1;
+				}
+				
+				got = recvmmsg(sockets[s], messages, PROXY_BATCH, MSG_DONTWAIT, NULL);
+				now = proxyClock::now();
+				if (got > 0) lastPacket = now;
+				
+				for (int b = 0; b < got; b++) {
+					batch[b]->length = messages[b].msg_len;
+					batch[b]->socket = s;
+					batch[b]->received = now;
+					handlePacket(batch[b], now);
+				}
+				for (int b = (got > 0) ? got : 0; b < PROXY_BATCH; b++)
+					freePackets.push_back(batch[b]);
+				
+				sendReady();
+			} while ((got == PROXY_BATCH) && (!failed));
+		}
+		
+		// Streams that have gone quiet give up the packets they hold. The
+		// algorithm still holds their samples, and would give them back
+		// into later packets, so the stream is passed on untouched from now on
+		now = proxyClock::now();
+		for (index_t i = 0; i < streams.size(); i++)
+			if ((!streams[i]->pending.empty()) &&
+				(now - streams[i]->lastSeen > std::chrono::milliseconds(PROXY_STREAM_IDLE_MS))) {
+				std::cout << "[RtpProxy] Stream " << std::hex << streams[i]->ssrc << std::dec
+					<< " went idle; passing it on untouched" << std::endl;
+				streams[i]->isDone = true;
+				releasePending(streams[i]);
+			}
+		sendReady();
+		
+		if (std::chrono::duration<double>(now - lastPacket).count() > idleSeconds) break;
+	}
+	close(poller);
+	
+	for (index_t i = 0; i < streams.size(); i++)
+		releasePending(streams[i]);
+	sendReady();
+	
+	// Totals, in order of first appearance
+	for (index_t i = 0; i < streams.size(); i++) {
+		proxyStream *stream = streams[i];
+		if (stream->assembler) stream->assembler->flush();
+		if (stream->extracted) stream->extracted->close();
+		if (stream->embedder) {
+			stream->samples = stream->embedder->samples;
+			stream->bits = stream->embedder->bits;
+			stream->metrics = stream->embedder->metrics;
+		}
+		stream->metrics.finish();
+		
+		processedSamples += stream->samples;
+		processedHiddenBits += stream->bits;
+		metrics.merge(stream->metrics);
+	}
+	
+	return !failed;
+}
+
+// Nearest rank
+double RtpProxy::latencyPercentile(double percent) const {
+	if (latencies.empty()) return 0;
+	
+	std::vector<float> sorted(latencies);
+	index_t rank = (index_t) ceil(percent / 100 * sorted.size());
+	if (rank > 0) rank--;
+	if (rank >= sorted.size()) rank = sorted.size() - 1;
+	std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.end());
+	return sorted[rank];
+}
+
+void RtpProxy::report(std::ostream *out) {
+	for (index_t i = 0; i < streams.size(); i++) {
+		proxyStream *stream = streams[i];
+		char ssrc[16];
+		sprintf(ssrc, "%08x", stream->ssrc);
+		
+		*out << "[RtpProxy] Stream " << ssrc << " (" << (stream->law == ULAW ? "u" : "a") << "law): "
+			<< stream->packets << " packets, " << stream->samples << " samples, "
+			<< stream->bits << " bits";
+		if (stream->extracted) *out << ", to " << stream->extractedFile;
+		*out << std::endl;
+	}
+	
+	*out << "[RtpProxy] " << streams.size() << " streams, " << processedPackets << " packets";
+	if (passedPackets) *out << ", " << passedPackets << " others passed over";
+	*out << std::endl;
+	
+	*out << "[RtpProxy] " << (isReceiver ? "Processing time" : "Added latency") << " (us): median "
+		<< latencyPercentile(50) << ", 95th percentile " << latencyPercentile(95)
+		<< ", 99th percentile " << latencyPercentile(99) << ", maximum " << latencyPercentile(100) << std::endl;
+}
+
+void RtpProxy::writeSummary(std::ostream *out) {
+	const char *what = isReceiver ? "Packet processing time" : "Packet added latency";
+	*out << std::fixed;
+	*out << what << " median us:\t" << latencyPercentile(50) << std::endl;
+	*out << what << " 95th percentile us:\t" << latencyPercentile(95) << std::endl;
+	*out << what << " 99th percentile us:\t" << latencyPercentile(99) << std::endl;
+	*out << what << " maximum us:\t" << latencyPercentile(100) << std::endl;
+}
+
+RtpProxy::~RtpProxy() {
+	for (index_t i = 0; i < streams.size(); i++) {
+		delete streams[i]->embedder;
+		delete streams[i]->bitSource;
+		delete streams[i]->algorithm;
+		delete streams[i]->extracted;
+		delete streams[i]->assembler;
+		delete streams[i];
+	}
+	for (index_t i = 0; i < freePackets.size(); i++)
+		delete freePackets[i];
+	for (index_t s = 0; s < sockets.size(); s++)
+		close(sockets[s]);
+}
+
+#endif
@@ -0,0 +1,155 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RTPPROXY_HPP
+#define RTPPROXY_HPP
+
+#include "G711StegAlgorithm.hpp"
+#include "BitProvider.hpp"
+#include "RtpHeader.hpp"
+#include "RtpStreams.hpp"
+#include "QualityMetrics.hpp"
+#include "StreamEmbedder.hpp"
+#include "BitAssembler.hpp"
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+
+// Packets taken from (or given to) a socket in one call
+#define PROXY_BATCH 64
+#define PROXY_PACKET_LENGTH 2048
+// Listening on more ports than this is probably a mistake
+#define PROXY_MAX_PORTS 1024
+// A stream without packets for this long has its held packets sent on
+#define PROXY_STREAM_IDLE_MS 200
+
+typedef std::chrono::steady_clock proxyClock;
+
+// A datagram, and where it's going
+typedef struct proxyPacketS {
+	unsigned char data[PROXY_PACKET_LENGTH];
+	length_t length;
+	index_t socket;
+	length_t payload, payloadLength, written;
+	proxyClock::time_point received;
+} proxyPacket;
+
+// One RTP stream (SSRC) and all that's needed to embed into or extract from it
+typedef struct proxyStreamS {
+	unsigned int ssrc;
+	bool law;
+	G711StegAlgorithm *algorithm;
+	proxyClock::time_point lastSeen;
+	
+	// Embedding
+	BitProvider *bitSource;
+	StreamEmbedder *embedder;
+	bool isDone; // Out of bits, or gone idle - later packets are passed on untouched
+	std::deque<proxyPacket*> pending; // Waiting for the algorithm to give back their samples
+	std::vector<G711Sample> tampered;
+	
+	// Extracting
+	std::ofstream *extracted;
+	std::string extractedFile;
+	BitAssembler *assembler;
+	
+	length_t packets, samples;
+	unsigned long long bits;
+	QualityMetrics metrics;
+} proxyStream;
+
+// Relays RTP from one set of UDP ports to another in real time, embedding
+// into each G711 stream (by SSRC) with its own copy of the algorithm as in
+// RtpStreams - or, as a receiver, extracts each stream to PREFIX.<ssrc>.
+// Everything is done on one thread: epoll waits on every listening socket,
+// and packets are taken and sent PROXY_BATCH at a time with recvmmsg and
+// sendmmsg. A packet is sent on once all its samples have been tampered
+// with, so algorithms that hold samples back hold packets back too.
+// Packets that aren't G711 RTP are passed on as they are.
+// The time from receiving each packet to sending it (or, as a receiver,
+// to finishing with it) is kept for percentiles.
+class RtpProxy {
+	private:
+		G711StegAlgorithm *prototype;
+		algorithmCopier copier;
+		bool isReceiver;
+		char *embedFile;
+		const char *extractPrefix;
+		double verifyFraction;
+		bool statistics;
+		double idleSeconds;
+		
+		std::vector<int> sockets;
+		std::vector<struct sockaddr_in> destinations;
+		std::vector<std::vector<proxyPacket*> > ready; // To send, per socket
+		std::vector<proxyPacket*> freePackets;
+		std::map<unsigned int, proxyStream*> bySsrc;
+		std::vector<proxyStream*> streams; // In order of first appearance
+		bool failed;
+		
+		std::vector<float> latencies; // Microseconds
+		
+		proxyPacket* newPacket();
+		proxyStream* newStream(unsigned int ssrc, bool law);
+		void handlePacket(proxyPacket *packet, const proxyClock::time_point &now);
+		bool embedPacket(proxyStream *stream, proxyPacket *packet);
+		void extractPacket(proxyStream *stream, proxyPacket *packet);
+		void releasePending(proxyStream *stream);
+		void sendReady();
+		void finish(proxyPacket *packet);
+		
+	public:
+		// Totals over every stream
+		length_t processedSamples, processedPackets, passedPackets;
+		unsigned long long processedHiddenBits;
+		QualityMetrics metrics;
+		
+		// As a receiver, extracts to extractPrefix; otherwise embeds
+		// embedFile (NULL for worst-case data) into each stream, keeping
+		// metrics only with statistics
+		RtpProxy(G711StegAlgorithm *prototype, algorithmCopier copier, bool isReceiver,
+			char *embedFile, const char *extractPrefix, double verifyFraction, bool statistics,
+			double idleSeconds);
+		
+		// IPv4 HOST:PORT or HOST:FIRST-LAST; gives the first and how many ports
+		static bool parseAddress(const char *text, struct sockaddr_in *address, unsigned int *ports);
+		
+		// Addresses are as for parseAddress. Packets arriving on
+		// the n-th listening port go to the n-th destination port, or to the
+		// only one given. Receivers have no destination.
+		bool open(const char *listen, const char *destination);
+		
+		// Until idleSeconds pass without a packet, or SIGINT
+		// Returns false if verification failed
+		bool run();
+		
+		// Percentile of the time packets spent here, in microseconds
+		double latencyPercentile(double percent) const;
+		
+		void report(std::ostream *out);
+		void writeSummary(std::ostream *out);
+		
+		~RtpProxy();
+};
+
+#endif
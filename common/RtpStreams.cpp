@@ -0,0 +1,281 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RTPSTREAMS_CPP
+#define RTPSTREAMS_CPP
+
+#include "RtpStreams.hpp"
+#include "FileBitProvider.hpp"
+#include "NoiseBitProvider.hpp"
+#include "BitPacker.hpp"
+#include <map>
+#include <thread>
+#include <cstring>
+#include <cstdio>
+
+RtpStreams::RtpStreams(G711StegAlgorithm *prototype, algorithmCopier copier,
+	const unsigned char *capture, size_t captureLength, unsigned char *output,
+	char *embedFile, const char *extractPrefix, double verifyFraction, bool statistics) :
+		prototype(prototype), copier(copier), capture(capture), captureLength(captureLength),
+		output(output), embedFile(embedFile), extractPrefix(extractPrefix),
+		verifyFraction(verifyFraction), statistics(statistics), failed(false),
+		processedSamples(0), processedHiddenBits(0) {}
+
+rtpStream* RtpStreams::newStream(unsigned int ssrc, bool law, unsigned int threads) {
+	rtpStream *stream = new rtpStream;
+	stream->ssrc = ssrc;
+	stream->law = law;
+	stream->worker = streams.size() % threads;
+	stream->algorithm = copier(prototype);
+	
+	stream->bitSource = NULL;
+	stream->embedder = NULL;
+	stream->isDone = false;
+	if (output) {
+		if (embedFile)
+			stream->bitSource = new FileBitProvider(embedFile);
+		else
+			stream->bitSource = new WorstNoiseBitProvider(stream->algorithm);
+		stream->embedder = new StreamEmbedder(stream->algorithm, stream->bitSource, verifyFraction, statistics);
+	}
+	
+	stream->extracted = NULL;
+	stream->assembler = NULL;
+	if (!output) {
+		char suffix[16];
+		sprintf(suffix, ".%08x", ssrc);
+		stream->extractedFile = std::string(extractPrefix) + suffix;
+		stream->extracted = new std::ofstream(stream->extractedFile.c_str(), std::ios::out | std::ios::binary);
+		stream->assembler = new BitAssembler(stream->extracted);
+	}
+	
+	stream->packets = stream->skipped = stream->samples = 0;
+	stream->bits = 0;
+	
+	streams.push_back(stream);
+	return stream;
+}
+
+void RtpStreams::writeSample(rtpStream *stream, const G711Sample &sample) {
+	rtpPendingPacket *front = &stream->pending.front();
+	output[front->packet.payload + front->written] = sample.transmissionSample();
+	
+	if (++front->written == front->packet.payloadLength) {
+		PcapReader::fixChecksum(output, front->packet);
+		stream->pending.pop_front();
+	}
+}
+
+bool RtpStreams::embedPacket(rtpStream *stream, const rtpPacket &packet) {
+	if (stream->isDone) return true;
+	
+	rtpPendingPacket pending = { packet, 0 };
+	stream->pending.push_back(pending);
+	
+	G711Sample samples[SAMPLES_PER_PACKET];
+	for (index_t start = 0; start < packet.payloadLength; start += SAMPLES_PER_PACKET) {
+		length_t count = packet.payloadLength - start;
+		if (count > SAMPLES_PER_PACKET) count = SAMPLES_PER_PACKET;
+		
+		for (index_t i = 0; i < count; i++)
+			samples[i] = G711Sample(stream->law, capture[packet.payload + start + i]);
+		
+		stream->tampered.clear();
+		if (!stream->embedder->embed(samples, count, &stream->tampered)) {
+			std::cout << "[RtpStreams] Stream " << std::hex << stream->ssrc << std::dec << " failed verification" << std::endl;
+			return false;
+		}
+		for (index_t i = 0; i < stream->tampered.size(); i++)
+			writeSample(stream, stream->tampered[i]);
+		
+		// As main stops reading once out of bits
+		if (stream->embedder->isDone()) {
+			stream->isDone = true;
+			break;
+		}
+	}
+	
+	return true;
+}
+
+// As main does when extracting from a file
+void RtpStreams::extractPacket(rtpStream *stream, const rtpPacket &packet) {
+	G711StegAlgorithm *algorithm = stream->algorithm;
+	G711Sample samples[SAMPLES_PER_PACKET];
+	steg_t hiddenData[SAMPLES_PER_PACKET];
+	length_t hiddenDataLength[SAMPLES_PER_PACKET];
+	int state[SAMPLES_PER_PACKET];
+	
+	for (index_t start = 0; start < packet.payloadLength; start += SAMPLES_PER_PACKET) {
+		length_t count = packet.payloadLength - start;
+		if (count > SAMPLES_PER_PACKET) count = SAMPLES_PER_PACKET;
+		
+		for (index_t i = 0; i < count; i++)
+			samples[i] = G711Sample(stream->law, capture[packet.payload + start + i]);
+		algorithm->pushTamperedSamples(samples, count);
+		
+		length_t sampleCount;
+		while ((sampleCount = algorithm->recoveredDataReadyForPop())) {
+			if (sampleCount > SAMPLES_PER_PACKET) sampleCount = SAMPLES_PER_PACKET;
+			sampleCount = algorithm->popRecoveredData(hiddenData, hiddenDataLength, state, sampleCount);
+			if (!sampleCount) break;
+			
+			stream->samples += sampleCount;
+			gatherBits(hiddenData, hiddenDataLength, sampleCount,
+				[&](unsigned long long bits, length_t bitCount) {
+					stream->bits += bitCount;
+					stream->assembler->append(bits, bitCount);
+				});
+		}
+	}
+}
+
+void RtpStreams::worker(index_t worker) {
+	SPSCQueue<rtpWork> *queue = queues[worker];
+	rtpWork work;
+	
+	while (true) {
+		if (!queue->tryPop(&work)) {
+			if (failed) return;
+			std::this_thread::yield();
+			continue;
+		}
+		if (!work.stream) return;
+		
+		if (output) {
+			if (!embedPacket(work.stream, work.packet))
+				failed = true;
+		} else {
+			extractPacket(work.stream, work.packet);
+		}
+	}
+}
+
+// Once the workers are done
+void RtpStreams::finishStream(rtpStream *stream) {
+	// A packet only partly tampered with when the data ran out
+	if (output && (!stream->pending.empty()) && (stream->pending.front().written))
+		PcapReader::fixChecksum(output, stream->pending.front().packet);
+	stream->pending.clear();
+	
+	if (stream->embedder) {
+		stream->samples = stream->embedder->samples;
+		stream->bits = stream->embedder->bits;
+		stream->metrics = stream->embedder->metrics;
+	}
+	stream->metrics.finish();
+	if (stream->assembler) stream->assembler->flush();
+	if (stream->extracted) stream->extracted->close();
+}
+
+bool RtpStreams::run(unsigned int threads) {
+	PcapReader reader(capture, captureLength);
+	if ((!PcapReader::isPcap(capture, captureLength)) || (!reader.isSupported())) {
+		std::cout << "[RtpStreams] Not a capture with a supported link type" << std::endl;
+		return false;
+	}
+	
+	for (index_t w = 0; w < threads; w++)
+		queues.push_back(new SPSCQueue<rtpWork>(RTP_QUEUE_LENGTH));
+	std::vector<std::thread> workers;
+	for (index_t w = 0; w < threads; w++)
+		workers.push_back(std::thread(&RtpStreams::worker, this, w));
+	
+	// Hand each RTP packet to its stream's worker, copying every record as it goes
+	std::map<unsigned int, rtpStream*> bySsrc;
+	size_t start = 0, length = PCAP_HEADER_LENGTH;
+	rtpWork work;
+	bool isRtp;
+	
+	if (output) memcpy(output, capture, PCAP_HEADER_LENGTH);
+	while ((!failed) && (reader.next(&start, &length, &work.packet, &isRtp))) {
+		if (output) memcpy(output + start, capture + start, length);
+		if (!isRtp) continue;
+		
+		bool law = (work.packet.payloadType == RTP_PAYLOAD_PCMU) ? ULAW : ALAW;
+		std::map<unsigned int, rtpStream*>::iterator found = bySsrc.find(work.packet.ssrc);
+		if (found == bySsrc.end())
+			found = bySsrc.insert(std::make_pair(work.packet.ssrc, newStream(work.packet.ssrc, law, threads))).first;
+		work.stream = found->second;
+		
+		// A stream changing law part way through only keeps its first
+		if (work.stream->law != law) {
+			work.stream->skipped++;
+			continue;
+		}
+		
+		work.stream->packets++;
+		while ((!queues[work.stream->worker]->tryPush(work)) && (!failed))
+			std::this_thread::yield();
+	}
+	
+	// Anything after the last whole record
+	if (output && (start + length < captureLength))
+		memcpy(output + start + length, capture + start + length, captureLength - start - length);
+	
+	work.stream = NULL;
+	for (index_t w = 0; w < threads; w++)
+		while ((!queues[w]->tryPush(work)) && (!failed))
+			std::this_thread::yield();
+	for (index_t w = 0; w < threads; w++)
+		workers[w].join();
+	
+	for (index_t s = 0; s < streams.size(); s++)
+		finishStream(streams[s]);
+	
+	if (failed) return false;
+	
+	// Totals, in order of first appearance
+	for (index_t s = 0; s < streams.size(); s++) {
+		processedSamples += streams[s]->samples;
+		processedHiddenBits += streams[s]->bits;
+		metrics.merge(streams[s]->metrics);
+	}
+	
+	return true;
+}
+
+void RtpStreams::report(std::ostream *out) {
+	for (index_t s = 0; s < streams.size(); s++) {
+		rtpStream *stream = streams[s];
+		char ssrc[16];
+		sprintf(ssrc, "%08x", stream->ssrc);
+		
+		*out << "[RtpStreams] Stream " << ssrc << " (" << (stream->law == ULAW ? "u" : "a") << "law): "
+			<< stream->packets << " packets, " << stream->samples << " samples, "
+			<< stream->bits << " bits";
+		if (stream->skipped) *out << ", " << stream->skipped << " packets of another law skipped";
+		if (stream->extracted) *out << ", to " << stream->extractedFile;
+		*out << std::endl;
+	}
+	*out << "[RtpStreams] " << streams.size() << " streams" << std::endl;
+}
+
+RtpStreams::~RtpStreams() {
+	for (index_t s = 0; s < streams.size(); s++) {
+		delete streams[s]->embedder;
+		delete streams[s]->bitSource;
+		delete streams[s]->algorithm;
+		delete streams[s]->extracted;
+		delete streams[s]->assembler;
+		delete streams[s];
+	}
+	for (index_t w = 0; w < queues.size(); w++)
+		delete queues[w];
+}
+
+#endif
@@ -0,0 +1,135 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef RTPSTREAMS_HPP
+#define RTPSTREAMS_HPP
+
+#include "G711StegAlgorithm.hpp"
+#include "BitProvider.hpp"
+#include "PcapFile.hpp"
+#include "QualityMetrics.hpp"
+#include "StreamEmbedder.hpp"
+#include "BitAssembler.hpp"
+#include "SPSCQueue.hpp"
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// Packets waiting for each worker
+#define RTP_QUEUE_LENGTH 256
+
+// Should make a new instance of the algorithm, set up the same as prototype
+typedef G711StegAlgorithm* (*algorithmCopier)(G711StegAlgorithm *prototype);
+
+// A packet with samples pushed for tampering, and how many have been written back
+typedef struct rtpPendingPacketS {
+	rtpPacket packet;
+	length_t written;
+} rtpPendingPacket;
+
+// One RTP stream (SSRC) and all that's needed to embed into or extract from it
+typedef struct rtpStreamS {
+	unsigned int ssrc;
+	bool law;
+	index_t worker;
+	G711StegAlgorithm *algorithm;
+	
+	// Embedding
+	BitProvider *bitSource;
+	StreamEmbedder *embedder;
+	bool isDone; // Out of bits - later packets are left alone
+	std::deque<rtpPendingPacket> pending;
+	std::vector<G711Sample> tampered;
+	
+	// Extracting
+	std::ofstream *extracted;
+	std::string extractedFile;
+	BitAssembler *assembler;
+	
+	// Statistics; packets and skipped are kept by the reading thread
+	length_t packets, skipped, samples;
+	unsigned long long bits;
+	QualityMetrics metrics;
+} rtpStream;
+
+// A packet handed to a worker; a NULL stream means there are no more
+typedef struct rtpWorkS {
+	rtpStream *stream;
+	rtpPacket packet;
+} rtpWork;
+
+// Embeds into or extracts from every G711 RTP stream in a pcap capture in
+// one pass. Each stream (by SSRC) is its own carrier, as if its payloads had
+// been stripped into a file: it has its own algorithm instance and the whole
+// payload (or worst-case data) is embedded into it from its first packet.
+// Streams are shared between worker threads, each stream's packets going
+// in capture order to one worker.
+// When embedding, the capture is copied record by record into output, with
+// the tampered payloads written in place and their UDP checksums fixed, so
+// headers and timestamps are kept. Packets after a stream runs out of data
+// are left as they were.
+// When extracting, each stream's data is written to OUTPUT.<SSRC in hex>.
+class RtpStreams {
+	private:
+		G711StegAlgorithm *prototype;
+		algorithmCopier copier;
+		const unsigned char *capture;
+		size_t captureLength;
+		unsigned char *output;
+		char *embedFile;
+		const char *extractPrefix;
+		double verifyFraction;
+		bool statistics;
+		
+		// In order of first appearance
+		std::vector<rtpStream*> streams;
+		std::vector<SPSCQueue<rtpWork>*> queues;
+		std::atomic<bool> failed;
+		
+		rtpStream* newStream(unsigned int ssrc, bool law, unsigned int threads);
+		void worker(index_t worker);
+		bool embedPacket(rtpStream *stream, const rtpPacket &packet);
+		void writeSample(rtpStream *stream, const G711Sample &sample);
+		void extractPacket(rtpStream *stream, const rtpPacket &packet);
+		void finishStream(rtpStream *stream);
+		
+	public:
+		// Totals over every stream, as kept by main for a single carrier
+		length_t processedSamples;
+		unsigned long long processedHiddenBits;
+		QualityMetrics metrics;
+		
+		// To embed, output must be as long as the capture, and embedFile is
+		// NULL for worst-case data; to extract, output is NULL
+		// Without statistics, metrics are left empty
+		RtpStreams(G711StegAlgorithm *prototype, algorithmCopier copier,
+			const unsigned char *capture, size_t captureLength, unsigned char *output,
+			char *embedFile, const char *extractPrefix, double verifyFraction, bool statistics);
+		
+		// Returns false if verification failed or the capture can't be read
+		bool run(unsigned int threads);
+		
+		// A line per stream
+		void report(std::ostream *out);
+		
+		~RtpStreams();
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SPSCQUEUE_HPP
+#define SPSCQUEUE_HPP
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+// A bounded, lock-free queue for exactly one producing thread and one
+// consuming thread. Neither side ever blocks; callers decide how to wait.
+template <class T>
+class SPSCQueue {
+	private:
+		std::vector<T> slots;
+		size_t mask;
+		
+		// Kept on separate cache lines, as each is written by a different thread
+		alignas(64) std::atomic<size_t> head; // Next slot to pop, written by the consumer
+		alignas(64) std::atomic<size_t> tail; // Next slot to push, written by the producer
+		
+		SPSCQueue(const SPSCQueue&);
+		SPSCQueue& operator=(const SPSCQueue&);
+		
+	public:
+		// Capacity is rounded up to a power of two
+		SPSCQueue(size_t capacity) : head(0), tail(0) {
+			size_t size = 1;
+			while (size < capacity) size <<= 1;
+			slots.resize(size);
+			mask = size - 1;
+		}
+		
+		// Producer only. Returns false if the queue is full.
+		bool tryPush(const T &item) {
+			size_t t = tail.load(std::memory_order_relaxed);
+			if (t - head.load(std::memory_order_acquire) > mask)
+				return false;
+			slots[t & mask] = item;
+			tail.store(t + 1, std::memory_order_release);
+			return true;
+		}
+		
+		// Consumer only. Returns false if the queue is empty.
+		bool tryPop(T *item) {
+			size_t h = head.load(std::memory_order_relaxed);
+			if (h == tail.load(std::memory_order_acquire))
+				return false;
+			*item = slots[h & mask];
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+		
+		// Only a snapshot if the other side is active
+		size_t size() const {
+			return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+		}
+		
+		size_t capacity() const { return mask + 1; }
+		
+		// Before C++17 plain new only aligns to 16 bytes, which would put
+		// head and tail back on a shared line
+		static void* operator new(size_t size) {
+			void *memory;
+			if (posix_memalign(&memory, alignof(SPSCQueue), size)) throw std::bad_alloc();
+			return memory;
+		}
+		
+		static void operator delete(void *memory) { free(memory); }
+};
+
+#endif
@@ -0,0 +1,263 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef SERIALEMBEDDER_HPP
+#define SERIALEMBEDDER_HPP
+
+#include "StegAlgorithm.hpp"
+#include "G711Sample.hpp"
+#include "QualityMetrics.hpp"
+#include "LatencyHistogram.hpp"
+#include "CarrierFile.hpp"
+#include "BitPacker.hpp"
+#include <queue>
+#include <deque>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+// Embeds on the calling thread, one step after another: read, embed, write
+// and verify. The caller may do the reading instead, to feed the same
+// samples to several. Templated on the algorithm and bit source so that,
+// with the concrete (final) classes, every per-sample call is bound
+// statically and can be inlined into the loop. Instantiate with
+// G711StegAlgorithm and BitProvider to go through the virtual interface.
+template <class Algo, class Bits>
+class SerialEmbedder {
+	private:
+		Algo *embedder;
+		Bits *bitSource;
+		CarrierReader *audio;
+		bool law;
+		length_t readLength;
+		CarrierWriter *output;
+		std::ofstream *detailed;
+		bool statistics;
+		double verifyFraction;
+		
+		// Popped samples go back in the same buffer, and an algorithm may pop up to a packet at once
+		std::vector<G711Sample> samplesBuffer;
+		
+		// For statistics, once the algorithm gives the samples back
+		std::deque<G711Sample> originals;
+		
+		// Samples given back during this call, written out and (unless
+		// details are wanted) added to the statistics once at the end of
+		// it rather than once per pop
+		std::vector<G711Sample> tampered;
+		
+		// For future verification
+		std::queue<steg_t> verifyEmbedData;
+		std::queue<length_t> verifyEmbedLength;
+		length_t pushedSamples;
+		
+		// Every so often, have the algorithm analyse the tampered samples
+		// from scratch rather than use what it expects of them
+		// Starts full, so the first samples are always checked in full
+		double verifyCredit;
+		
+		// Embeds the count samples at the start of samplesBuffer
+		bool embedBuffered(length_t count);
+		
+		// Statistics for count samples given back by the algorithm, the
+		// first of them being sample first; the rest may be NULL if there
+		// are no details to write
+		void addStatistics(const G711Sample *samples, length_t count, index_t first,
+			const steg_t *hiddenData, const length_t *hiddenDataLength, const int *state);
+		
+	public:
+		// Totals, as kept by EmbedPipeline and ChunkEmbedder
+		length_t processedSamples, processedHiddenBits;
+		QualityMetrics metrics;
+		LatencyHistogram latency;
+		
+		// output may be NULL if only the statistics are wanted, and
+		// detailed may be NULL if no detailed statistics are wanted.
+		// Without statistics, originals aren't kept or decoded at all,
+		// and only the sample and bit counts are kept.
+		SerialEmbedder(Algo *embedder, Bits *bitSource, CarrierReader *audio, bool law,
+			length_t readLength, CarrierWriter *output, std::ofstream *detailed,
+			bool statistics, double verifyFraction) :
+			embedder(embedder), bitSource(bitSource), audio(audio), law(law),
+			readLength(readLength), output(output), detailed(detailed),
+			statistics(statistics || detailed), verifyFraction(verifyFraction),
+			samplesBuffer(readLength > SAMPLES_PER_PACKET ? readLength : SAMPLES_PER_PACKET),
+			pushedSamples(0), verifyCredit(1), processedSamples(0),
+			processedHiddenBits(0) {}
+		
+		// Whether the bit source has run out
+		bool isDone() { return !bitSource->remainingBits(); }
+		
+		// Embeds the next count samples of the audio (up to readLength),
+		// given by the caller rather than read; returns false if
+		// verification failed
+		bool embed(const G711Sample *samples, length_t count) {
+			std::copy(samples, samples + count, samplesBuffer.begin());
+			return embedBuffered(count);
+		}
+		
+		// Reads and embeds until the audio or the bits run out; returns
+		// false if verification failed
+		bool run();
+};
+
+template <class Algo, class Bits>
+bool SerialEmbedder<Algo, Bits>::run() {
+	length_t sampleCount;
+	while ((sampleCount = audio->read(law, &samplesBuffer[0], readLength)) && (!isDone()))
+		if (!embedBuffered(sampleCount)) return false;
+	
+	return true;
+}
+
+template <class Algo, class Bits>
+bool SerialEmbedder<Algo, Bits>::embedBuffered(length_t sampleCount) {
+	G711Sample *samples = &samplesBuffer[0];
+	index_t sampleIndex;
+	
+	steg_t hiddenData[SAMPLES_PER_PACKET];
+	length_t hiddenDataLength[SAMPLES_PER_PACKET];
+	steg_t hiddenDataMask;
+	int state[SAMPLES_PER_PACKET] = { 0 };
+	
+	steg_t expData, actData;
+	length_t expLen, actLen;
+	
+	if (statistics) originals.insert(originals.end(), samples, samples + sampleCount);
+	
+	embedder->pushUntamperedSamples(samples, sampleCount);
+	pushedSamples += sampleCount;
+	while ((embedder->untamperedSamplesReadyForPop()) && (bitSource->remainingBits())) {
+		
+		sampleCount = embedder->minimumSamplesForPop();
+		if (sampleCount > SAMPLES_PER_PACKET) {
+			std::cout << "[SerialEmbedder] Buffer length exceeded for algorithm minimum" << std::endl;
+			return false;
+		}
+		
+		// Keep in mind we're doing the minimum number of samples for a successful pop.
+		// There might be a few extra 0 bits at the end of the file as a result.
+		// The alternative would be to add the check for remaining bits to this for loop -
+		// but then we'd not finish working on the samples and the end of the file would
+		// be cut off.
+		embedder->capacities(hiddenDataLength, sampleCount);
+		processedHiddenBits += scatterBits(bitSource, hiddenDataLength, sampleCount, hiddenData);
+		
+		// For later verification
+		for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
+			verifyEmbedData.push(hiddenData[sampleIndex]);
+			verifyEmbedLength.push(hiddenDataLength[sampleIndex]);
+		}
+		
+		sampleCount = embedder->popTamperedSamples(samples, hiddenData, state, sampleCount);
+		
+		// Keep new samples to write out, do detailed statistics
+		tampered.insert(tampered.end(), samples, samples + sampleCount);
+		if (detailed)
+			addStatistics(samples, sampleCount, processedSamples, hiddenData, hiddenDataLength, state);
+		processedSamples += sampleCount;
+		
+		// Verify embedded data
+		verifyCredit += verifyFraction;
+		if (verifyCredit >= 1) {
+			verifyCredit -= 1;
+			embedder->pushTamperedSamples(samples, sampleCount);
+		} else {
+			embedder->pushTamperedSamplesExpected(samples, sampleCount);
+		}
+		
+		sampleCount = embedder->recoveredDataReadyForPop();
+		sampleCount = embedder->popRecoveredData(hiddenData, hiddenDataLength, state, sampleCount);
+		
+		for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
+			expData = verifyEmbedData.front();
+			verifyEmbedData.pop();
+			actData = hiddenData[sampleIndex];
+			
+			expLen = verifyEmbedLength.front();
+			verifyEmbedLength.pop();
+			actLen = hiddenDataLength[sampleIndex];
+			
+			if (expLen != actLen) {
+				std::cout << "[SerialEmbedder] Corruption detected: expected length "
+					<< expLen << "; got length " << actLen << std::endl;
+				return false;
+			} else {
+				hiddenDataMask = (1 << expLen) - 1;
+				expData &= hiddenDataMask;
+				actData &= hiddenDataMask;
+				if (expData != actData) {
+					std::cout << "[SerialEmbedder] Corruption detected: expected data "
+						<< expData << "; got data " << actData << std::endl;
+					return false;
+				}
+			}
+		}
+	}
+	
+	if (!tampered.empty()) {
+		if (output) output->put(&tampered[0], tampered.size());
+		if ((statistics) && (!detailed))
+			addStatistics(&tampered[0], tampered.size(), processedSamples - tampered.size(), NULL, NULL, NULL);
+		tampered.clear();
+	}
+	
+	return true;
+}
+
+// A packet at a time: decode both sides to linear first, and hand the
+// arrays to the metrics.
+template <class Algo, class Bits>
+void SerialEmbedder<Algo, Bits>::addStatistics(const G711Sample *samples, length_t count, index_t first,
+	const steg_t *hiddenData, const length_t *hiddenDataLength, const int *state) {
+	linearAudio original[SAMPLES_PER_PACKET], modified[SAMPLES_PER_PACKET];
+	index_t sampleIndex;
+	
+	for (index_t start = 0; start < count; start += SAMPLES_PER_PACKET) {
+		length_t sampleCount = count - start;
+		if (sampleCount > SAMPLES_PER_PACKET) sampleCount = SAMPLES_PER_PACKET;
+		std::deque<G711Sample>::const_iterator originalSample = originals.begin();
+		
+		for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++, originalSample++) {
+			original[sampleIndex] = originalSample->linearSample();
+			modified[sampleIndex] = samples[start + sampleIndex].linearSample();
+		}
+		
+		for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++)
+			latency.add(pushedSamples - 1 - (first + start + sampleIndex));
+		metrics.add(original, modified, sampleCount);
+		
+		if (hiddenData) {
+			for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
+				*detailed << (first + start + sampleIndex + 1) << "\t";
+				*detailed << originals[sampleIndex].uninvertedSignedSample() << "\t";
+				*detailed << state[start + sampleIndex] << "\t";
+				*detailed << samples[start + sampleIndex].uninvertedSignedSample() << "\t";
+				*detailed << (hiddenData[start + sampleIndex] & ((1 << hiddenDataLength[start + sampleIndex]) - 1)) << "\t";
+				*detailed << hiddenDataLength[start + sampleIndex] << "\t";
+				if (original[sampleIndex])
+					*detailed << NoiseTotals::sampleNSR(original[sampleIndex], modified[sampleIndex]) << std::endl;
+				else
+					*detailed << "n/a" << std::endl;
+			}
+		}
+		
+		originals.erase(originals.begin(), originals.begin() + sampleCount);
+	}
+}
+
+#endif
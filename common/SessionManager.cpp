@@ -0,0 +1,293 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SESSIONMANAGER_CPP
+#define SESSIONMANAGER_CPP
+
+#include "SessionManager.hpp"
+#include "MemoryBitProvider.hpp"
+#include "NoiseBitProvider.hpp"
+#include <pthread.h>
+#include <chrono>
+#include <cstring>
+
+SessionManager::SessionManager(G711StegAlgorithm *prototype, algorithmCopier copier,
+	char *embedFile, double verifyFraction, bool statistics, unsigned int shardCount) :
+		prototype(prototype), copier(copier), payload(NULL), verifyFraction(verifyFraction),
+		statistics(statistics), stopping(false), failed(false), nextPop(0), processedSamples(0),
+		processedPackets(0), processedCalls(0), processedHiddenBits(0), processingSeconds(0) {
+	if (!shardCount) shardCount = std::thread::hardware_concurrency();
+	if (!shardCount) shardCount = 1;
+	
+	if (embedFile) {
+		payload = new MappedFile(embedFile);
+		if (!payload->isOpen()) {
+			std::cout << "[SessionManager] Couldn't open " << embedFile << std::endl;
+			failed = true;
+		}
+	}
+	
+	for (index_t s = 0; s < shardCount; s++) {
+		sessionShard *shard = new sessionShard;
+		shard->in = new SPSCQueue<sessionPacket>(SESSION_QUEUE_LENGTH);
+		shard->out = new SPSCQueue<sessionPacket>(SESSION_QUEUE_LENGTH);
+		shard->finished = false;
+		shard->callsEnded = shard->packets = shard->samples = 0;
+		shard->payloadEnded = 0;
+		shard->bits = 0;
+		shard->busySeconds = 0;
+		shards.push_back(shard);
+	}
+}
+
+void SessionManager::start() {
+	unsigned int cores = std::thread::hardware_concurrency();
+	
+	for (index_t s = 0; s < shards.size(); s++) {
+		shards[s]->thread = std::thread(&SessionManager::worker, this, s);
+		
+		if (cores) {
+			cpu_set_t set;
+			CPU_ZERO(&set);
+			CPU_SET(s % cores, &set);
+			pthread_setaffinity_np(shards[s]->thread.native_handle(), sizeof(set), &set);
+		}
+	}
+}
+
+bool SessionManager::push(callId call, bool law, const g711Audio *samples, length_t count) {
+	if ((!count) || (count > SESSION_MAX_SAMPLES)) return false;
+	
+	sessionPacket packet;
+	packet.call = call;
+	packet.law = law;
+	packet.length = count;
+	memcpy(packet.samples, samples, count * sizeof(g711Audio));
+	return shards[shardOf(call)]->in->tryPush(packet);
+}
+
+bool SessionManager::end(callId call) {
+	sessionPacket packet;
+	packet.call = call;
+	packet.law = ALAW;
+	packet.length = 0;
+	return shards[shardOf(call)]->in->tryPush(packet);
+}
+
+bool SessionManager::pop(sessionPacket *packet) {
+	// Round robin, so no shard is left waiting on a full queue
+	for (index_t tried = 0; tried < shards.size(); tried++) {
+		index_t s = nextPop;
+		if (++nextPop == shards.size()) nextPop = 0;
+		if (shards[s]->out->tryPop(packet)) return true;
+	}
+	return false;
+}
+
+sessionCall* SessionManager::newCall(bool law) {
+	sessionCall *call = new sessionCall;
+	call->algorithm = copier(prototype);
+	if (payload)
+		call->bitSource = new MemoryBitProvider(payload->data(), payload->size());
+	else
+		call->bitSource = new WorstNoiseBitProvider(call->algorithm);
+	call->embedder = new StreamEmbedder(call->algorithm, call->bitSource, verifyFraction, statistics);
+	call->law = law;
+	call->isDone = false;
+	call->written = 0;
+	call->packets = 0;
+	return call;
+}
+
+// Back to the pushing thread, waiting for room if need be
+void SessionManager::hand(sessionShard *shard, const sessionPacket &packet) {
+	while (!shard->out->tryPush(packet))
+		std::this_thread::yield();
+}
+
+// Hand back whatever a call is holding, as it is
+void SessionManager::release(sessionCall *call, sessionShard *shard) {
+	while (!call->pending.empty()) {
+		hand(shard, call->pending.front());
+		call->pending.pop_front();
+	}
+	call->written = 0;
+}
+
+bool SessionManager::embed(sessionCall *call, const sessionPacket &packet, sessionShard *shard) {
+	G711Sample samples[SAMPLES_PER_PACKET];
+	call->pending.push_back(packet);
+	
+	for (index_t start = 0; (start < packet.length) && (!call->isDone); start += SAMPLES_PER_PACKET) {
+		length_t count = packet.length - start;
+		if (count > SAMPLES_PER_PACKET) count = SAMPLES_PER_PACKET;
+		
+		for (index_t i = 0; i < count; i++)
+			samples[i] = G711Sample(call->law, packet.samples[start + i]);
+		
+		call->tampered.clear();
+		if (!call->embedder->embed(samples, count, &call->tampered)) {
+			std::cout << "[SessionManager] Call " << packet.call << " failed verification" << std::endl;
+			return false;
+		}
+		
+		for (index_t i = 0; i < call->tampered.size(); i++) {
+			sessionPacket *front = &call->pending.front();
+			front->samples[call->written] = call->tampered[i].transmissionSample();
+			if (++call->written == front->length) {
+				hand(shard, *front);
+				call->pending.pop_front();
+				call->written = 0;
+			}
+		}
+		
+		// Nothing more will be tampered with, so nothing more is held back
+		if (call->embedder->isDone()) {
+			call->isDone = true;
+			release(call, shard);
+		}
+	}
+	
+	return true;
+}
+
+void SessionManager::endCall(sessionShard *shard, callId id, sessionCall *call) {
+	shard->callsEnded++;
+	shard->packets += call->packets;
+	shard->samples += call->embedder->samples;
+	shard->bits += call->embedder->bits;
+	if ((payload) && (!call->bitSource->remainingBits())) shard->payloadEnded++;
+	call->embedder->metrics.finish();
+	shard->noise.merge(call->embedder->metrics.noise());
+	
+	delete call->embedder;
+	delete call->bitSource;
+	delete call->algorithm;
+	delete call;
+	shard->calls.erase(id);
+}
+
+bool SessionManager::handle(sessionShard *shard, const sessionPacket &packet) {
+	std::unordered_map<callId, sessionCall*>::iterator found = shard->calls.find(packet.call);
+	
+	if (!packet.length) {
+		// Ending a call that never started still gets its answer
+		if (found != shard->calls.end()) {
+			release(found->second, shard);
+			endCall(shard, packet.call, found->second);
+		}
+		hand(shard, packet);
+		return true;
+	}
+	
+	if (found == shard->calls.end())
+		found = shard->calls.insert(std::make_pair(packet.call, newCall(packet.law))).first;
+	sessionCall *call = found->second;
+	
+	// A call changing law part way through only keeps its first
+	if ((call->isDone) || (call->law != packet.law)) {
+		hand(shard, packet);
+		return true;
+	}
+	
+	call->packets++;
+	return embed(call, packet, shard);
+}
+
+void SessionManager::worker(index_t s) {
+	sessionShard *shard = shards[s];
+	std::vector<sessionPacket> batch(SESSION_BATCH);
+	unsigned int idle = 0;
+	
+	while (true) {
+		length_t count = 0;
+		while ((count < SESSION_BATCH) && (shard->in->tryPop(&batch[count])))
+			count++;
+		
+		if (!count) {
+			if (stopping) break;
+			if (++idle < SESSION_IDLE_SPINS) {
+				std::this_thread::yield();
+			} else {
+				std::this_thread::sleep_for(std::chrono::microseconds(SESSION_IDLE_SLEEP_US));
+			}
+			continue;
+		}
+		idle = 0;
+		
+		std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+		for (index_t i = 0; (i < count) && (!failed); i++)
+			if (!handle(shard, batch[i])) failed = true;
+		std::chrono::duration<double> spent = std::chrono::steady_clock::now() - started;
+		shard->busySeconds += spent.count();
+		
+		if (failed) break;
+	}
+	
+	shard->finished = true;
+}
+
+void SessionManager::stop() {
+	if (stopping) return;
+	stopping = true;
+	
+	// Anything still coming back is dropped, so no shard waits on a full queue
+	sessionPacket packet;
+	for (index_t s = 0; s < shards.size(); s++) {
+		if (!shards[s]->thread.joinable()) continue; // Never started
+		while (!shards[s]->finished)
+			if (!shards[s]->out->tryPop(&packet)) std::this_thread::yield();
+		shards[s]->thread.join();
+	}
+	
+	for (index_t s = 0; s < shards.size(); s++) {
+		sessionShard *shard = shards[s];
+		while (!shard->calls.empty())
+			endCall(shard, shard->calls.begin()->first, shard->calls.begin()->second);
+		
+		processedCalls += shard->callsEnded;
+		processedPackets += shard->packets;
+		processedSamples += shard->samples;
+		processedHiddenBits += shard->bits;
+		noise.merge(shard->noise);
+		processingSeconds += shard->busySeconds;
+	}
+}
+
+void SessionManager::report(std::ostream *out) {
+	for (index_t s = 0; s < shards.size(); s++) {
+		sessionShard *shard = shards[s];
+		*out << "[SessionManager] Shard " << s << ": " << shard->callsEnded << " calls, "
+			<< shard->packets << " packets, " << shard->samples << " samples, "
+			<< shard->bits << " bits, " << shard->busySeconds << " s busy" << std::endl;
+		if (shard->payloadEnded)
+			*out << "[SessionManager] Shard " << s << ": " << shard->payloadEnded
+				<< " calls used up the payload" << std::endl;
+	}
+}
+
+SessionManager::~SessionManager() {
+	stop();
+	for (index_t s = 0; s < shards.size(); s++) {
+		delete shards[s]->in;
+		delete shards[s]->out;
+		delete shards[s];
+	}
+	delete payload;
+}
+
+#endif
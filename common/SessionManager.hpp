@@ -0,0 +1,155 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef SESSIONMANAGER_HPP
+#define SESSIONMANAGER_HPP
+
+#include "G711StegAlgorithm.hpp"
+#include "BitProvider.hpp"
+#include "StreamEmbedder.hpp"
+#include "NoiseTotals.hpp"
+#include "RtpStreams.hpp"
+#include "SPSCQueue.hpp"
+#include "MappedFile.hpp"
+#include <unordered_map>
+#include <deque>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <iostream>
+
+// Longest run of samples pushed for a call at once: 40ms
+#define SESSION_MAX_SAMPLES (2 * SAMPLES_PER_PACKET)
+// Packets waiting for (or from) each shard
+#define SESSION_QUEUE_LENGTH 4096
+// Packets a shard takes from its queue before handing any back
+#define SESSION_BATCH 64
+// Times an idle shard yields before sleeping
+#define SESSION_IDLE_SPINS 1000
+#define SESSION_IDLE_SLEEP_US 100
+
+typedef unsigned long long callId;
+
+// Samples of a call, on their way to or from its shard. Going to a shard,
+// a packet with no samples ends the call; coming back, it says the call
+// has ended and nothing more will come back for it.
+typedef struct sessionPacketS {
+	callId call;
+	bool law;
+	length_t length;
+	g711Audio samples[SESSION_MAX_SAMPLES];
+} sessionPacket;
+
+// A call, as kept by its shard
+typedef struct sessionCallS {
+	G711StegAlgorithm *algorithm;
+	BitProvider *bitSource;
+	StreamEmbedder *embedder;
+	bool law;
+	bool isDone; // Out of bits - later packets come back untouched
+	std::deque<sessionPacket> pending; // Waiting for the algorithm to give back their samples
+	length_t written; // Into the first pending packet
+	std::vector<G711Sample> tampered;
+	length_t packets;
+} sessionCall;
+
+// A worker thread, the calls pinned to it, and the queues to and from it.
+// Only the shard's thread touches its calls.
+typedef struct sessionShardS {
+	SPSCQueue<sessionPacket> *in, *out;
+	std::unordered_map<callId, sessionCall*> calls;
+	std::thread thread;
+	std::atomic<bool> finished;
+	
+	// Read once stopped
+	length_t callsEnded, packets, samples;
+	length_t payloadEnded; // Calls that used up the whole payload
+	unsigned long long bits;
+	NoiseTotals noise;
+	double busySeconds;
+} sessionShard;
+
+// Embeds into thousands of simultaneous calls, each (by call ID) with its
+// own copy of the algorithm and its own bits, as RtpStreams does for the
+// streams of a capture. Calls are pinned to shards by ID, one shard per
+// core, and each shard's thread takes packets from its queue in batches,
+// so there are no locks: one thread pushes and pops, and each shard only
+// shares its two single-producer queues with it.
+// Tampered packets come back per call in the order they were pushed, each
+// once the algorithm has given back all its samples.
+class SessionManager {
+	private:
+		G711StegAlgorithm *prototype;
+		algorithmCopier copier;
+		MappedFile *payload; // Read once, shared by every call
+		double verifyFraction;
+		bool statistics;
+		
+		std::vector<sessionShard*> shards;
+		std::atomic<bool> stopping, failed;
+		index_t nextPop;
+		
+		void worker(index_t shard);
+		sessionCall* newCall(bool law);
+		bool handle(sessionShard *shard, const sessionPacket &packet);
+		bool embed(sessionCall *call, const sessionPacket &packet, sessionShard *shard);
+		void release(sessionCall *call, sessionShard *shard);
+		void hand(sessionShard *shard, const sessionPacket &packet);
+		void endCall(sessionShard *shard, callId id, sessionCall *call);
+		
+	public:
+		// Totals over every ended call, once stopped
+		length_t processedSamples, processedPackets, processedCalls;
+		unsigned long long processedHiddenBits;
+		NoiseTotals noise;
+		double processingSeconds; // Summed over the shards
+		
+		// embedFile is NULL for worst-case data; shardCount 0 is one per core
+		// Without statistics, noise is left empty
+		SessionManager(G711StegAlgorithm *prototype, algorithmCopier copier,
+			char *embedFile, double verifyFraction, bool statistics, unsigned int shardCount);
+		
+		// Starts the shards, each pinned to a core
+		void start();
+		
+		index_t shardOf(callId call) const { return call % shards.size(); }
+		length_t shardCount() const { return shards.size(); }
+		
+		// Only from the thread that starts the manager. Both return false
+		// if the call's shard is backed up: pop, then try again.
+		// count is at most SESSION_MAX_SAMPLES; the first push starts a call.
+		bool push(callId call, bool law, const g711Audio *samples, length_t count);
+		bool end(callId call);
+		
+		// Only from the thread that starts the manager. Takes a packet that
+		// has come back from any shard, returning false if there are none.
+		bool pop(sessionPacket *packet);
+		
+		// False once a call has failed verification
+		bool isFailed() const { return failed; }
+		
+		// Waits for the shards to finish what has been pushed; calls not yet
+		// ended are dropped, as is anything not popped
+		void stop();
+		
+		// A line per shard
+		void report(std::ostream *out);
+		
+		~SessionManager();
+};
+
+#endif
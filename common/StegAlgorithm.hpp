@@ -18,6 +18,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef STEGALGORITHM_HPP
 #define STEGALGORITHM_HPP
 
+#include <string>
+
 // Any array length/index should be an unsigned int
 typedef unsigned int length_t;
 typedef unsigned int index_t;
@@ -26,6 +28,14 @@ typedef unsigned int index_t;
 // LSB will contain the first secret bit; further secret bits will use increasingly more significant bits
 typedef unsigned int steg_t;
 
+// What an algorithm worked out about one untampered sample, in a form that
+// can be saved and given back to skip the analysis next time
+// metadata is whatever else the algorithm needs, if anything
+typedef struct capacityRecordS {
+	unsigned char bits;
+	unsigned char metadata;
+} capacityRecord;
+
 /*
 Class description for a simple steganography algorithm.
 Implementations should behave like two queues -
@@ -54,6 +64,26 @@ class StegAlgorithm {
 		// index should not equal or exceed a value returned by untamperedSamplesReadyForPop()
 		virtual length_t bitsAvailableForEncode(index_t index) = 0;
 
+		// should fill out with bitsAvailableForEncode() of the next count
+		// samples to be popped (count not exceeding untamperedSamplesReadyForPop())
+		// in one go, rather than one virtual call and lookup per sample
+		// by default, calls bitsAvailableForEncode() for each of them
+		virtual void capacities(length_t *out, length_t count) {
+			for (index_t i = 0; i < count; i++)
+				out[i] = bitsAvailableForEncode(i);
+		}
+
+		// should return the number of bits that can be embedded
+		// into all of the samples ready for tampering
+		// by default, sums bitsAvailableForEncode() over each of them
+		virtual length_t bitsAvailableTotal() {
+			length_t total = 0;
+			length_t ready = untamperedSamplesReadyForPop();
+			for (index_t i = 0; i < ready; i++)
+				total += bitsAvailableForEncode(i);
+			return total;
+		}
+
 		// for the number of samples given by length parameter, should:
 		// - take the next sample to be popped (FIFO - least recent to be pushed),
 		// - embed the bits given by stegData parameter,
@@ -74,6 +104,15 @@ class StegAlgorithm {
 		// algorithm should NOT rely on the samples pointer remaining valid post-call
 		virtual void pushTamperedSamples(const S *samples, length_t length) = 0;
 
+		// same as pushTamperedSamples, but samples must be exactly those
+		// returned by the last call to popTamperedSamples, in order
+		// algorithm can reuse what it worked out while tampering them
+		// instead of analysing them again, if it can do so more cheaply
+		// by default, just calls pushTamperedSamples
+		virtual void pushTamperedSamplesExpected(const S *samples, length_t length) {
+			pushTamperedSamples(samples, length);
+		}
+
 		// should return the number of samples fully processed and
 		// ready to recover the original hidden data
 		virtual length_t recoveredDataReadyForPop() = 0;
@@ -92,6 +131,40 @@ class StegAlgorithm {
 		// should reset any algorithm state regarding samples with hidden data to be recovered
 		virtual void resetTampered() = 0;
 
+		// should return true only if the capacity and tampering of every
+		// sample depend on nothing but that sample (and the algorithm's
+		// options), so separate instances can embed separate parts of
+		// the audio in any order
+		virtual bool isSampleIndependent() { return false; }
+
+		// should return how many samples may have to be pushed after a
+		// sample before it can be popped - any lookahead or buffering,
+		// so the delay the algorithm itself adds to a live stream
+		virtual length_t latencySamples() { return 0; }
+
+		// if the capacity of (and any other analysis needed for) every sample
+		// depends only on the untampered audio and the algorithm's options,
+		// should return a short string naming the algorithm and those options
+		// otherwise, an empty string
+		virtual std::string capacityKey() { return std::string(); }
+
+		// should describe a sample ready for tampering (see bitsAvailableForEncode)
+		// only called if capacityKey() isn't empty
+		virtual void recordCapacity(index_t index, capacityRecord *record) {
+			record->bits = bitsAvailableForEncode(index);
+			record->metadata = 0;
+		}
+
+		// if records isn't NULL, untampered samples pushed from now on should
+		// take their analysis from the records, in order, instead of working
+		// it out; records must cover every sample that will be pushed
+		// only called if capacityKey() isn't empty
+		virtual void useCapacityRecords(const capacityRecord*) {}
+
+		// may use up to the given number of threads for any work that
+		// can be split up; algorithms that can't should ignore this
+		virtual void setWorkerThreads(unsigned int) {}
+
 		virtual ~StegAlgorithm() {}
 };
 
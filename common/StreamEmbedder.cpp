@@ -0,0 +1,98 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMEMBEDDER_CPP
+#define STREAMEMBEDDER_CPP
+
+#include "StreamEmbedder.hpp"
+#include "BitPacker.hpp"
+#include <iostream>
+
+StreamEmbedder::StreamEmbedder(G711StegAlgorithm *algorithm, BitProvider *bitSource, double verifyFraction,
+	bool statistics) :
+	algorithm(algorithm), bitSource(bitSource), verifyFraction(verifyFraction), verifyCredit(1),
+	statistics(statistics), pushed(0), samples(0), bits(0) {}
+
+bool StreamEmbedder::embed(const G711Sample *samplesIn, length_t count, std::vector<G711Sample> *tamperedOut) {
+	G711Sample tampered[SAMPLES_PER_PACKET];
+	steg_t hiddenData[SAMPLES_PER_PACKET];
+	length_t hiddenDataLength[SAMPLES_PER_PACKET];
+	int state[SAMPLES_PER_PACKET];
+	linearAudio original[SAMPLES_PER_PACKET], modified[SAMPLES_PER_PACKET];
+	
+	if (statistics) originals.insert(originals.end(), samplesIn, samplesIn + count);
+	algorithm->pushUntamperedSamples(samplesIn, count);
+	pushed += count;
+	
+	while ((algorithm->untamperedSamplesReadyForPop()) && (bitSource->remainingBits())) {
+		length_t sampleCount = algorithm->minimumSamplesForPop();
+		if (sampleCount > SAMPLES_PER_PACKET) {
+			std::cout << "[StreamEmbedder] Buffer length exceeded for algorithm minimum" << std::endl;
+			return false;
+		}
+		
+		algorithm->capacities(hiddenDataLength, sampleCount);
+		bits += scatterBits(bitSource, hiddenDataLength, sampleCount, hiddenData);
+		verifyData.insert(verifyData.end(), hiddenData, hiddenData + sampleCount);
+		verifyLength.insert(verifyLength.end(), hiddenDataLength, hiddenDataLength + sampleCount);
+		
+		sampleCount = algorithm->popTamperedSamples(tampered, hiddenData, state, sampleCount);
+		
+		tamperedOut->insert(tamperedOut->end(), tampered, tampered + sampleCount);
+		samples += sampleCount;
+		
+		// A pop at a time, decoded to linear first
+		if (statistics) {
+			for (index_t i = 0; i < sampleCount; i++) {
+				original[i] = originals[i].linearSample();
+				modified[i] = tampered[i].linearSample();
+			}
+			originals.erase(originals.begin(), originals.begin() + sampleCount);
+			metrics.add(original, modified, sampleCount);
+		}
+		
+		// Verify embedded data
+		verifyCredit += verifyFraction;
+		if (verifyCredit >= 1) {
+			verifyCredit -= 1;
+			algorithm->pushTamperedSamples(tampered, sampleCount);
+		} else {
+			algorithm->pushTamperedSamplesExpected(tampered, sampleCount);
+		}
+		
+		sampleCount = algorithm->recoveredDataReadyForPop();
+		sampleCount = algorithm->popRecoveredData(hiddenData, hiddenDataLength, state, sampleCount);
+		
+		for (index_t i = 0; i < sampleCount; i++) {
+			length_t expLen = verifyLength.front();
+			steg_t mask = (1 << expLen) - 1;
+			steg_t expData = verifyData.front() & mask;
+			verifyLength.pop_front();
+			verifyData.pop_front();
+			
+			if ((expLen != hiddenDataLength[i]) || (expData != (hiddenData[i] & mask))) {
+				std::cout << "[StreamEmbedder] Corruption detected: expected " << expData << " in " << expLen
+					<< " bits; got " << (hiddenData[i] & mask) << " in " << hiddenDataLength[i] << " bits" << std::endl;
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+#endif
@@ -0,0 +1,65 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef STREAMEMBEDDER_HPP
+#define STREAMEMBEDDER_HPP
+
+#include "G711StegAlgorithm.hpp"
+#include "BitProvider.hpp"
+#include "QualityMetrics.hpp"
+#include <deque>
+#include <vector>
+
+// Embeds into a stream of samples handed over a packet at a time, as main
+// does into a file: bits come from bitSource, every popped sample is
+// verified (fully for verifyFraction of pops, otherwise against the
+// algorithm's expectations), and statistics are kept if wanted. Used for
+// each stream of a capture, proxy or session, which have their own algorithm.
+// The algorithm and bit source are the caller's.
+class StreamEmbedder {
+	private:
+		G711StegAlgorithm *algorithm;
+		BitProvider *bitSource;
+		double verifyFraction, verifyCredit;
+		bool statistics;
+		length_t pushed;
+		std::deque<G711Sample> originals; // Only kept for statistics
+		std::deque<steg_t> verifyData;
+		std::deque<length_t> verifyLength;
+		
+	public:
+		length_t samples;
+		unsigned long long bits;
+		QualityMetrics metrics;
+		
+		// Without statistics, originals aren't kept or decoded at all
+		StreamEmbedder(G711StegAlgorithm *algorithm, BitProvider *bitSource, double verifyFraction,
+			bool statistics);
+		
+		// Out of bits, so nothing more will be tampered with
+		bool isDone() { return !bitSource->remainingBits(); }
+		
+		// Samples pushed but not yet given back
+		length_t held() const { return pushed - samples; }
+		
+		// Pushes up to SAMPLES_PER_PACKET samples, appending to tampered
+		// whatever the algorithm gives back (which may include samples held
+		// from earlier pushes). Returns false if verification failed.
+		bool embed(const G711Sample *samples, length_t count, std::vector<G711Sample> *tampered);
+};
+
+#endif
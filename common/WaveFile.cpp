@@ -0,0 +1,108 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WAVEFILE_CPP
+#define WAVEFILE_CPP
+
+#include "WaveFile.hpp"
+#include "G711Sample.hpp"
+#include <cstring>
+
+static unsigned int readLittle(const unsigned char *data, unsigned int bytes) {
+	unsigned int value = 0;
+	for (unsigned int i = 0; i < bytes; i++)
+		value |= ((unsigned int) data[i]) << (8 * i);
+	return value;
+}
+
+static void putLittle(std::vector<unsigned char> *out, unsigned int value, unsigned int bytes) {
+	for (unsigned int i = 0; i < bytes; i++)
+		out->push_back((value >> (8 * i)) & 0xFF);
+}
+
+static void putTag(std::vector<unsigned char> *out, const char *tag) {
+	out->insert(out->end(), tag, tag + 4);
+}
+
+bool WaveFile::parse(const unsigned char *data, size_t size, waveInfo *info) {
+	if ((size < 12) || memcmp(data, "RIFF", 4) || memcmp(data + 8, "WAVE", 4))
+		return false;
+	
+	bool haveFormat = false;
+	size_t position = 12;
+	while (position + 8 <= size) {
+		const unsigned char *chunk = data + position;
+		size_t chunkLength = readLittle(chunk + 4, 4);
+		
+		if (!memcmp(chunk, "fmt ", 4)) {
+			if ((chunkLength < 16) || (position + 8 + 16 > size)) return false;
+			info->format = readLittle(chunk + 8, 2);
+			info->channels = readLittle(chunk + 10, 2);
+			info->sampleRate = readLittle(chunk + 12, 4);
+			info->bitsPerSample = readLittle(chunk + 22, 2);
+			haveFormat = true;
+		} else if (!memcmp(chunk, "data", 4)) {
+			info->dataOffset = position + 8;
+			info->dataLength = size - info->dataOffset;
+			if (chunkLength < info->dataLength) info->dataLength = chunkLength;
+			return haveFormat;
+		}
+		
+		// Chunks are padded to an even length
+		position += 8 + chunkLength + (chunkLength & 1);
+	}
+	
+	return false;
+}
+
+void WaveFile::header(unsigned short format, unsigned long long samples, std::vector<unsigned char> *out) {
+	bool isPCM = (format == WAVE_FORMAT_PCM);
+	unsigned int bytesPerSample = isPCM ? 2 : 1;
+	unsigned int dataLength = samples * bytesPerSample;
+	
+	out->clear();
+	putTag(out, "RIFF");
+	putLittle(out, 0, 4); // Filled in below
+	putTag(out, "WAVE");
+	
+	putTag(out, "fmt ");
+	putLittle(out, isPCM ? 16 : 18, 4);
+	putLittle(out, format, 2);
+	putLittle(out, 1, 2);
+	putLittle(out, SAMPLES_PER_SECOND, 4);
+	putLittle(out, SAMPLES_PER_SECOND * bytesPerSample, 4);
+	putLittle(out, bytesPerSample, 2);
+	putLittle(out, 8 * bytesPerSample, 2);
+	
+	// Formats other than PCM have an (empty) extension and a sample count
+	if (!isPCM) {
+		putLittle(out, 0, 2);
+		putTag(out, "fact");
+		putLittle(out, 4, 4);
+		putLittle(out, samples, 4);
+	}
+	
+	putTag(out, "data");
+	putLittle(out, dataLength, 4);
+	
+	// Odd lengths of data are followed by a pad byte
+	unsigned int riffLength = out->size() - 8 + dataLength + (dataLength & 1);
+	for (unsigned int i = 0; i < 4; i++)
+		(*out)[4 + i] = (riffLength >> (8 * i)) & 0xFF;
+}
+
+#endif
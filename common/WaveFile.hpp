@@ -0,0 +1,57 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef WAVEFILE_HPP
+#define WAVEFILE_HPP
+
+#include <cstddef>
+#include <vector>
+
+#define WAVE_FORMAT_PCM 1
+#define WAVE_FORMAT_ALAW 6
+#define WAVE_FORMAT_MULAW 7
+
+// What a RIFF/WAVE header says, and where its samples are
+typedef struct waveInfoS {
+	unsigned short format;
+	unsigned short channels;
+	unsigned int sampleRate;
+	unsigned short bitsPerSample;
+	size_t dataOffset;
+	size_t dataLength;
+} waveInfo;
+
+// Reading and writing the RIFF/WAVE wrapping of G711 (and 16-bit PCM) audio
+class WaveFile {
+	public:
+		// Parses a header from the start of a file in memory; false if it isn't one
+		// dataLength is cut short if the file is
+		static bool parse(const unsigned char *data, size_t size, waveInfo *info);
+		
+		// True for mono 8-bit alaw or ulaw
+		static bool isG711(const waveInfo &info) {
+			return ((info.format == WAVE_FORMAT_ALAW) || (info.format == WAVE_FORMAT_MULAW)) &&
+				(info.channels == 1) && (info.bitsPerSample == 8);
+		}
+		
+		// A header for mono 8kHz audio of the given format and number of samples
+		// Always the same length for a format, so it can be rewritten once the
+		// number of samples is known
+		static void header(unsigned short format, unsigned long long samples, std::vector<unsigned char> *out);
+};
+
+#endif
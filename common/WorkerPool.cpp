@@ -0,0 +1,86 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef WORKERPOOL_CPP
+#define WORKERPOOL_CPP
+
+#include "WorkerPool.hpp"
+
+WorkerPool::WorkerPool(unsigned int threads) :
+	task(NULL), tasks(0), nextTask(0), running(0), generation(0), stopping(false) {
+	for (unsigned int t = 1; t < threads; t++)
+		this->threads.push_back(std::thread(&WorkerPool::worker, this));
+}
+
+void WorkerPool::work() {
+	unsigned int next;
+	while ((next = nextTask++) < tasks)
+		(*task)(next);
+}
+
+void WorkerPool::worker() {
+	unsigned long long seen = 0;
+	std::unique_lock<std::mutex> guard(lock);
+	
+	while (true) {
+		started.wait(guard, [&]() { return (stopping) || (generation != seen); });
+		if (stopping) return;
+		seen = generation;
+		
+		guard.unlock();
+		work();
+		guard.lock();
+		
+		if (!--running) finished.notify_one();
+	}
+}
+
+void WorkerPool::run(unsigned int count, const std::function<void(unsigned int)> &task) {
+	if (threads.empty()) {
+		for (unsigned int t = 0; t < count; t++)
+			task(t);
+		return;
+	}
+	
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		this->task = &task;
+		tasks = count;
+		nextTask = 0;
+		running = threads.size();
+		generation++;
+	}
+	started.notify_all();
+	
+	work();
+	
+	// Every thread must be done with the task before it goes away
+	std::unique_lock<std::mutex> guard(lock);
+	finished.wait(guard, [&]() { return !running; });
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		stopping = true;
+	}
+	started.notify_all();
+	
+	for (unsigned int t = 0; t < threads.size(); t++)
+		threads[t].join();
+}
+
+#endif
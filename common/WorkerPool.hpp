@@ -0,0 +1,64 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#ifndef WORKERPOOL_HPP
+#define WORKERPOOL_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <vector>
+
+// Threads started once and kept waiting, for work that is split up again
+// and again (such as every push to an algorithm), so no thread is made or
+// joined per call. The calling thread takes a share of the work too.
+class WorkerPool {
+	private:
+		std::vector<std::thread> threads;
+		std::mutex lock;
+		std::condition_variable started, finished;
+		
+		// The current run, handed out under lock
+		const std::function<void(unsigned int)> *task;
+		unsigned int tasks;
+		std::atomic<unsigned int> nextTask;
+		unsigned int running; // Threads still working on this run
+		unsigned long long generation;
+		bool stopping;
+		
+		void worker();
+		void work();
+		
+		WorkerPool(const WorkerPool&);
+		WorkerPool& operator=(const WorkerPool&);
+		
+	public:
+		// threads counts the calling thread, so 1 starts none
+		WorkerPool(unsigned int threads);
+		
+		// Threads the work is shared between, counting the caller
+		unsigned int size() const { return threads.size() + 1; }
+		
+		// Calls task(0) to task(count - 1), each once and in any order, on
+		// any of the threads; returns once all have returned
+		void run(unsigned int count, const std::function<void(unsigned int)> &task);
+		
+		~WorkerPool();
+};
+
+#endif
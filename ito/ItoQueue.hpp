@@ -33,11 +33,11 @@ The authors of the above mentioned paper do not endorse this work.
 #ifndef ITOQUEUE_HPP
 #define ITOQUEUE_HPP
 
-#include <list>
+#include <deque>
 #include "ItoCommon.hpp"
 #include "ItoG711Sample.hpp"
 
-typedef std::list<ItoG711Sample*> itoSampleList;
+typedef std::deque<ItoG711Sample*> itoSampleList;
 
 class ItoQueue {
 	public:
@@ -46,7 +46,14 @@ class ItoQueue {
 		
 		ItoQueue() {}
 		
-		virtual ~ItoQueue() {}
+		// Remove (and free) every sample
+		void clear() {
+			for (itoSampleList::iterator it = samples.begin(); it != samples.end(); it++)
+				delete *it;
+			samples.clear();
+		}
+		
+		virtual ~ItoQueue() { clear(); }
 };
 
 #endif
@@ -37,11 +37,15 @@ The authors of the above mentioned paper do not endorse this work.
 #include <cstdlib>
 #include <iostream>
 #include "ItoStegAlgorithm.hpp"
+#include "../common/NoisePatternTable.hpp"
 
 ItoStegAlgorithm::ItoStegAlgorithm(unsigned int g726bitrate) {
 	g726Bitrate = g726bitrate;
 	recalcBitrateAttrs();
 	untamperedSending = tamperedReceiving = NULL;
+	lastPoppedUsed = 0;
+	usingExpected = false;
+	knownCapacity = NULL;
 }
 
 ItoStegAlgorithm* ItoStegAlgorithm::lastArgp = NULL;
@@ -128,6 +132,35 @@ ItoG711Sample* ItoStegAlgorithm::processSample(G711Sample sample, g726_state_t *
 	return toReturn;
 }
 
+ItoG711Sample* ItoStegAlgorithm::processExpectedSample(G711Sample sample, const ItoG711Sample *expected, g726_state_t *state) {
+	ItoG711Sample *toReturn = newSample();
+	*toReturn = *expected;
+	toReturn->sample = sample;
+	
+	// processSample leaves the codec as it was after encoding the sample
+	// with every bit it can hide cleared, which tampering doesn't change
+	G711Sample lowTamper = sample;
+	lowTamper &= (g711Audio) ~((1 << expected->bits) - 1);
+	
+	g726_state_t lastLowState;
+	runG726(state, lowTamper, &lastLowState);
+	*state = lastLowState;
+	
+	return toReturn;
+}
+
+// Records keep the G726 result in the low bits of the metadata
+#define KNOWN_MAX_DELTA 0x80
+
+ItoG711Sample* ItoStegAlgorithm::processKnownSample(G711Sample sample, const capacityRecord *record) {
+	ItoG711Sample *toReturn = newSample();
+	toReturn->sample = sample;
+	toReturn->bits = record->bits;
+	toReturn->result = record->metadata & ~KNOWN_MAX_DELTA;
+	toReturn->maxDelta = record->metadata & KNOWN_MAX_DELTA;
+	return toReturn;
+}
+
 g726Audio ItoStegAlgorithm::runG726(g726_state_t *sourceState, G711Sample sample, g726_state_t *destState) {
 	memcpy(destState, sourceState, sizeof(g726_state_t));
 	int16_t a = (int16_t) sample.linearSample();
@@ -137,30 +170,34 @@ g726Audio ItoStegAlgorithm::runG726(g726_state_t *sourceState, G711Sample sample
 }
 
 inline ItoG711Sample* ItoStegAlgorithm::getUntamperedSample(index_t forIndex) {
-	ItoG711Sample* sample = NULL;
-	if (forIndex < untamperedSamplesReadyForPop()) {
-		itoSampleList::iterator it = untamperedSending->samples.begin();
-		for (index_t i = 0; i < forIndex; i++) it++;
-		sample = *it;
-	}
-	return sample;
+	if (forIndex < untamperedSamplesReadyForPop())
+		return untamperedSending->samples[forIndex];
+	return NULL;
 }
 
-G711Sample ItoStegAlgorithm::produceTampering(ItoG711Sample *sample, steg_t hiddenData) {
+// Tampering only depends on the sample and how many bits it can carry
+static G711Sample itoTamper(G711Sample sample, length_t bits, steg_t hiddenData) {
 	unsigned char audioMask = 1;
 	steg_t stegMask = 1;
-	G711Sample toReturn = sample->sample;
-	for (index_t i = 0; i < sample->bits; i++) {
+	for (index_t i = 0; i < bits; i++) {
 		if (hiddenData & stegMask) {
-			toReturn |= audioMask;
+			sample |= audioMask;
 		} else {
-			toReturn &= ~audioMask;
+			sample &= ~audioMask;
 		}
 		
 		audioMask <<= 1;
 		stegMask <<= 1;
 	}
-	return toReturn;
+	return sample;
+}
+
+// So the noisiest and quietest patterns for every sample and capacity (up
+// to the 4 bits processSample allows) are only worked out once
+static const NoisePatternTable itoPatterns(itoTamper, 4);
+
+G711Sample ItoStegAlgorithm::produceTampering(ItoG711Sample *sample, steg_t hiddenData) {
+	return itoTamper(sample->sample, sample->bits, hiddenData);
 }
 
 length_t ItoStegAlgorithm::recoverHidden(ItoG711Sample *sample, steg_t *hiddenData) {
@@ -183,7 +220,13 @@ void ItoStegAlgorithm::postToQueue(G711Sample sample, ItoQueue **toQueue) {
 		*toQueue = allocQueue();
 		resetQueue(*toQueue);
 	}
-	(*toQueue)->samples.push_back(processSample(sample, &((*toQueue)->lowerCodec)));
+	if (usingKnownCapacity(toQueue))
+		(*toQueue)->samples.push_back(processKnownSample(sample, knownCapacity++));
+	else if (usingExpected && (lastPoppedUsed < lastPopped.size()))
+		(*toQueue)->samples.push_back(processExpectedSample(sample,
+			&lastPopped[lastPoppedUsed++], &((*toQueue)->lowerCodec)));
+	else
+		(*toQueue)->samples.push_back(processSample(sample, &((*toQueue)->lowerCodec)));
 }
 
 inline void ItoStegAlgorithm::recalcBitrateAttrs() {
@@ -215,16 +258,34 @@ length_t ItoStegAlgorithm::bitsAvailableForEncode(index_t index) {
 	return sample->bits;
 }
 
+// One walk of the queue, rather than one per sample
+void ItoStegAlgorithm::capacities(length_t *out, length_t count) {
+	itoSampleList::iterator it = untamperedSending->samples.begin();
+	for (index_t i = 0; i < count; i++) {
+		if (it == untamperedSending->samples.end()) {
+			out[i] = 0;
+		} else {
+			out[i] = (*it)->bits;
+			it++;
+		}
+	}
+}
+
 length_t ItoStegAlgorithm::popTamperedSamples(G711Sample *samples, const steg_t *stegData, int *state, length_t length) {
 	length_t size = untamperedSamplesReadyForPop();
 	if (length > size) length = size;
 	
+	lastPopped.clear();
+	lastPoppedUsed = 0;
+	
 	for (index_t i = 0; i < length; i++) {
 		ItoG711Sample* sample = untamperedSending->samples.front();
 		
 		state[i] = g726signedValue(sample->result);
 		samples[i] = produceTampering(sample, stegData[i]);
 		
+		lastPopped.push_back(*sample);
+		delete sample;
 		untamperedSending->samples.pop_front();
 	}
 	
@@ -237,7 +298,7 @@ ItoQueue* ItoStegAlgorithm::allocQueue() {
 
 void ItoStegAlgorithm::resetQueue(ItoQueue *queue) {
 	g726_init(&(queue->lowerCodec), g726Bitrate, G726_ENCODING_LINEAR, G726_PACKING_NONE);
-	queue->samples.clear();
+	queue->clear();
 }
 
 void ItoStegAlgorithm::resetUntampered() {
@@ -249,6 +310,12 @@ void ItoStegAlgorithm::pushTamperedSamples(const G711Sample *samples, length_t l
 		postToQueue(samples[i], &tamperedReceiving);
 }
 
+void ItoStegAlgorithm::pushTamperedSamplesExpected(const G711Sample *samples, length_t length) {
+	usingExpected = true;
+	pushTamperedSamples(samples, length);
+	usingExpected = false;
+}
+
 length_t ItoStegAlgorithm::recoveredDataReadyForPop() {
 	return tamperedReceiving->samples.size();
 }
@@ -263,6 +330,7 @@ length_t ItoStegAlgorithm::popRecoveredData(steg_t *stegData, length_t *bitLengt
 		state[i] = g726signedValue(sample->result);
 		bitLength[i] = recoverHidden(sample, &(stegData[i]));
 		
+		delete sample;
 		tamperedReceiving->samples.pop_front();
 	}
 	
@@ -279,12 +347,35 @@ G711Sample ItoStegAlgorithm::getNewlyTamperedSample(index_t forIndex, steg_t giv
 	return produceTampering(sample, givenSteg);
 }
 
+// The same choice as getNoisiestExtremePatternOnly, from the table
+steg_t ItoStegAlgorithm::getNoisiestBitPattern(index_t index) {
+	ItoG711Sample *sample = getUntamperedSample(index);
+	if (sample == NULL) return 0;
+	return itoPatterns.noisiest(sample->sample, sample->bits);
+}
+
+steg_t ItoStegAlgorithm::getQuietestBitPattern(index_t index) {
+	ItoG711Sample *sample = getUntamperedSample(index);
+	if (sample == NULL) return 0;
+	return itoPatterns.quietest(sample->sample, sample->bits);
+}
+
 G711Sample ItoStegAlgorithm::getUntamperedOut(index_t index) {
 	ItoG711Sample *sample = getUntamperedSample(index);
 	if (sample == NULL) return G711Sample();
 	return sample->sample;
 }
 
+std::string ItoStegAlgorithm::capacityKey() {
+	return "ito/" + std::to_string(g726Bitrate);
+}
+
+void ItoStegAlgorithm::recordCapacity(index_t index, capacityRecord *record) {
+	ItoG711Sample *sample = getUntamperedSample(index);
+	record->bits = sample ? sample->bits : 0;
+	record->metadata = sample ? (sample->result | (sample->maxDelta ? KNOWN_MAX_DELTA : 0)) : 0;
+}
+
 short ItoStegAlgorithm::g726signedValue(g726Audio a) {
 	if (a < g726sign) return a;
 	else return a + 1 - g726max;
@@ -36,8 +36,8 @@ The authors of the above mentioned paper do not endorse this work.
 #include "ItoCommon.hpp"
 #include "ItoQueue.hpp"
 #include "ItoOptions.hpp"
-#include "../common/G711getNoisiestExtremePatternOnly.hpp"
 #include "../common/InitOptions.hpp"
+#include <vector>
 
 class ItoStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 	friend error_t itoParser(int key, char *arg, struct argp_state *state);
@@ -53,13 +53,38 @@ class ItoStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 		unsigned int g726Bitrate;
 		ItoQueue *untamperedSending, *tamperedReceiving;
 		
+		// What was worked out for the samples of the last popTamperedSamples
+		// call, and how many of them pushTamperedSamplesExpected has used
+		std::vector<ItoG711Sample> lastPopped;
+		index_t lastPoppedUsed;
+		bool usingExpected;
+		
+		// Analysis of the untampered samples still to be pushed, if known
+		// in advance (see useCapacityRecords)
+		const capacityRecord *knownCapacity;
+		
+		// Whether samples posted to the given queue take their analysis
+		// from knownCapacity
+		bool usingKnownCapacity(ItoQueue **toQueue) {
+			return knownCapacity && (toQueue == &untamperedSending);
+		}
+		
 		// Generate a new ItoG711Sample instance
 		virtual ItoG711Sample* newSample();
 		
 		// Processes a sample, updates the state provided
 		virtual ItoG711Sample* processSample(G711Sample sample, g726_state_t *state);
 		
-		// Has a sample processed (by processSample) and adds it to the queue
+		// Same result as processSample for a sample tampered from one that
+		// was processed into expected, but with only one G726 encode
+		virtual ItoG711Sample* processExpectedSample(G711Sample sample, const ItoG711Sample *expected, g726_state_t *state);
+		
+		// Same result as processSample, but taken from a record of it
+		virtual ItoG711Sample* processKnownSample(G711Sample sample, const capacityRecord *record);
+		
+		// Has a sample processed (by processSample, or processExpectedSample
+		// while pushing expected samples, or processKnownSample while using
+		// capacity records) and adds it to the queue
 		// Will update the codec state in the queue
 		// If the queue doesn't yet exist, it will first be created
 		virtual void postToQueue(G711Sample sample, ItoQueue **toQueue);
@@ -87,26 +112,34 @@ class ItoStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 		short g726signedValue(g726Audio a);
 		
 		// Inherited functions
-		virtual G711Sample getNewlyTamperedSample(index_t forIndex, steg_t givenSteg);
-		virtual G711Sample getUntamperedOut(index_t index);
+		// Those here and below that NealStegAlgorithm doesn't override are
+		// final, so calls to them through an ItoStegAlgorithm are bound statically
+		virtual G711Sample getNewlyTamperedSample(index_t forIndex, steg_t givenSteg) final;
+		virtual G711Sample getUntamperedOut(index_t index) final;
 		
 	public:
 		ItoStegAlgorithm(unsigned int g726bitrate = 40000);
 	
 		// Inherited functions - G711StegAlgorithm
-		virtual steg_t getNoisiestBitPattern(index_t index) {
-			return getNoisiestExtremePatternOnly(index, this);
-		}
+		virtual steg_t getNoisiestBitPattern(index_t index) final;
+		virtual steg_t getQuietestBitPattern(index_t index) final;
 		virtual void pushUntamperedSamples(const G711Sample *samples, length_t length);
-		virtual length_t untamperedSamplesReadyForPop();
-		virtual length_t minimumSamplesForPop();
-		virtual length_t bitsAvailableForEncode(index_t index);
-		virtual length_t popTamperedSamples(G711Sample *samples, const steg_t *stegData, int *state, length_t length);
+		virtual length_t untamperedSamplesReadyForPop() final;
+		virtual length_t minimumSamplesForPop() final;
+		virtual length_t bitsAvailableForEncode(index_t index) final;
+		virtual void capacities(length_t *out, length_t count) final;
+		virtual length_t popTamperedSamples(G711Sample *samples, const steg_t *stegData, int *state, length_t length) final;
 		virtual void resetUntampered();
 		virtual void pushTamperedSamples(const G711Sample *samples, length_t length);
-		virtual length_t recoveredDataReadyForPop();
-		virtual length_t popRecoveredData(steg_t *stegData, length_t *bitLength, int *state, length_t length);
+		virtual void pushTamperedSamplesExpected(const G711Sample *samples, length_t length) final;
+		virtual length_t recoveredDataReadyForPop() final;
+		virtual length_t popRecoveredData(steg_t *stegData, length_t *bitLength, int *state, length_t length) final;
 		virtual void resetTampered();
+		virtual std::string capacityKey();
+		virtual void recordCapacity(index_t index, capacityRecord *record);
+		virtual void useCapacityRecords(const capacityRecord *records) {
+			knownCapacity = records;
+		}
 		
 		// Inherited functions - InitOptions
 		virtual error_t argp(int key, char *arg, struct argp_state *state);
@@ -0,0 +1,143 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LSBKERNEL_CPP
+#define LSBKERNEL_CPP
+
+#include "LSBKernel.hpp"
+#include <string.h>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define LSB_HAVE_AVX2
+#endif
+
+#define BYTE_LSBS 0x0101010101010101ULL
+
+// Spread 8 bits to the LSBs of 8 bytes; even and odd bits are multiplied
+// separately so the partial products never collide
+static inline unsigned long long spreadBits(unsigned long long b) {
+	return (((b & 0x55) * 0x02040810204081ULL) | ((b & 0xAA) * 0x02040810204081ULL)) & BYTE_LSBS;
+}
+
+// Gather the LSBs of 8 bytes into 8 bits
+static inline unsigned long long gatherBits(unsigned long long w) {
+	return ((w & BYTE_LSBS) * 0x0102040810204080ULL) >> 56;
+}
+
+static inline unsigned long long lsbFlip(bool law) {
+	return ((law == ULAW ? INVERT_MASK_ULAW : INVERT_MASK_ALAW) & 1) ? BYTE_LSBS : 0;
+}
+
+// Scalar path, 8 samples per 64 bit word
+static void lsbEmbedScalar(bool law, const g711Audio *in, const unsigned long long *bits,
+	g711Audio *out, index_t from, length_t length) {
+	
+	unsigned long long flip = lsbFlip(law);
+	index_t i = from;
+	for (; i + 8 <= length; i += 8) {
+		unsigned long long w;
+		memcpy(&w, in + i, 8);
+		w = (w & ~BYTE_LSBS) | (spreadBits((bits[i / 64] >> (i % 64)) & 0xFF) ^ flip);
+		memcpy(out + i, &w, 8);
+	}
+	for (; i < length; i++)
+		out[i] = (in[i] & ~1) | (((bits[i / 64] >> (i % 64)) & 1) ^ (flip & 1));
+}
+
+static void lsbExtractScalar(bool law, const g711Audio *in, unsigned long long *bits,
+	index_t from, length_t length) {
+	
+	unsigned long long flip = lsbFlip(law);
+	index_t i = from;
+	for (; i + 8 <= length; i += 8) {
+		unsigned long long w;
+		memcpy(&w, in + i, 8);
+		bits[i / 64] |= gatherBits(w ^ flip) << (i % 64);
+	}
+	for (; i < length; i++)
+		bits[i / 64] |= (unsigned long long)((in[i] ^ flip) & 1) << (i % 64);
+}
+
+#ifdef LSB_HAVE_AVX2
+// AVX2 path, 32 samples per register
+__attribute__((target("avx2")))
+static index_t lsbEmbedAVX2(bool law, const g711Audio *in, const unsigned long long *bits,
+	g711Audio *out, length_t length) {
+	
+	// Byte n of the register takes bit n of the 32 bit group:
+	// shuffle byte n/8 of the group into byte n, then test bit n%8
+	const __m256i spread = _mm256_setr_epi8(
+		0,0,0,0,0,0,0,0, 1,1,1,1,1,1,1,1, 2,2,2,2,2,2,2,2, 3,3,3,3,3,3,3,3);
+	const __m256i select = _mm256_set1_epi64x(0x8040201008040201ULL);
+	const __m256i lsb = _mm256_set1_epi8(1);
+	const __m256i flip = _mm256_set1_epi8(lsbFlip(law) & 1);
+	
+	index_t i = 0;
+	for (; i + 32 <= length; i += 32) {
+		unsigned int group = bits[i / 64] >> (i % 64);
+		__m256i b = _mm256_shuffle_epi8(_mm256_set1_epi32(group), spread);
+		b = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(b, select), select), lsb);
+		
+		__m256i t = _mm256_loadu_si256((const __m256i*)(in + i));
+		t = _mm256_or_si256(_mm256_andnot_si256(lsb, t), _mm256_xor_si256(b, flip));
+		_mm256_storeu_si256((__m256i*)(out + i), t);
+	}
+	return i;
+}
+
+__attribute__((target("avx2")))
+static index_t lsbExtractAVX2(bool law, const g711Audio *in, unsigned long long *bits, length_t length) {
+	const __m256i flip = _mm256_set1_epi8(lsbFlip(law) & 1);
+	
+	index_t i = 0;
+	for (; i + 32 <= length; i += 32) {
+		__m256i t = _mm256_xor_si256(_mm256_loadu_si256((const __m256i*)(in + i)), flip);
+		// Move each LSB up to the sign bit of its byte for movemask
+		unsigned int group = _mm256_movemask_epi8(_mm256_slli_epi16(t, 7));
+		bits[i / 64] |= (unsigned long long) group << (i % 64);
+	}
+	return i;
+}
+
+// Checked once; a function-local static is initialised safely even when
+// several threads first get here together
+static bool lsbUseAVX2() {
+	static const bool supported = __builtin_cpu_supports("avx2");
+	return supported;
+}
+#endif
+
+void lsbEmbed(bool law, const g711Audio *in, const unsigned long long *bits, g711Audio *out, length_t length) {
+	index_t done = 0;
+#ifdef LSB_HAVE_AVX2
+	if (lsbUseAVX2())
+		done = lsbEmbedAVX2(law, in, bits, out, length);
+#endif
+	lsbEmbedScalar(law, in, bits, out, done, length);
+}
+
+void lsbExtract(bool law, const g711Audio *in, unsigned long long *bits, length_t length) {
+	memset(bits, 0, ((length + 63) / 64) * sizeof(unsigned long long));
+	index_t done = 0;
+#ifdef LSB_HAVE_AVX2
+	if (lsbUseAVX2())
+		done = lsbExtractAVX2(law, in, bits, length);
+#endif
+	lsbExtractScalar(law, in, bits, done, length);
+}
+
+#endif
@@ -0,0 +1,36 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LSBKERNEL_HPP
+#define LSBKERNEL_HPP
+
+#include "../common/G711Sample.hpp"
+#include "../common/StegAlgorithm.hpp"
+
+// Packet-level kernels for one hidden bit in the LSB of every sample.
+// Hidden bits are packed LSB first: bit (i % 64) of bits[i / 64] belongs
+// to sample i. Both work directly on transmitted bytes; the LSB of either
+// inversion mask is folded in rather than uninverting each sample.
+
+// Write the bits into the uninverted LSBs of length transmitted bytes
+void lsbEmbed(bool law, const g711Audio *in, const unsigned long long *bits, g711Audio *out, length_t length);
+
+// Read the uninverted LSBs of length transmitted bytes into bits
+// Any unused high bits of the last word are cleared
+void lsbExtract(bool law, const g711Audio *in, unsigned long long *bits, length_t length);
+
+#endif
@@ -20,15 +20,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../common/G711StegAlgorithm.hpp"
 #include "../common/InitOptions.hpp"
-#include <list>
+#include "LSBKernel.hpp"
+#include <deque>
 
 static struct argp_child lsbArgp[] = {
 	{ 0 }
 };
 
-class LSBStegAlgorithm : public G711StegAlgorithm, public InitOptions {
+class LSBStegAlgorithm final : public G711StegAlgorithm, public InitOptions {
 	private:
-		std::list<G711Sample> untamperedSending, tamperedReceiving;
+		std::deque<G711Sample> untamperedSending, tamperedReceiving;
 	
 	protected:
 		// Inherited functions
@@ -45,9 +46,7 @@ class LSBStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 			if (index >= untamperedSending.size())
 				return G711Sample();
 			
-			std::list<G711Sample>::iterator it = untamperedSending.begin();
-			for (index_t i = 0; i < index; i++) it++;
-			return *it;
+			return untamperedSending[index];
 		}
 		
 	public:
@@ -58,6 +57,10 @@ class LSBStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 			return getUntamperedOut(index).uninvertedSample() & 1 ? 0 : 1;
 		}
 		
+		steg_t getQuietestBitPattern(index_t index) {
+			return getUntamperedOut(index).uninvertedSample() & 1;
+		}
+		
 		void pushUntamperedSamples(const G711Sample *samples, length_t length) {
 			for (index_t i = 0; i < length; i++) untamperedSending.push_back(samples[i]);
 		}
@@ -74,13 +77,35 @@ class LSBStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 			return 1;
 		}
 		
+		void capacities(length_t *out, length_t count) {
+			for (index_t i = 0; i < count; i++) out[i] = 1;
+		}
+		
 		length_t popTamperedSamples(G711Sample *samples, const steg_t *stegData, int *state, length_t length) {
 			length_t size = untamperedSending.size();
 			if (length > size) length = size;
-			for (index_t i = 0; i < length; i++) {
-				samples[i] = getNewlyTamperedSample(0, stegData[i]);
-				untamperedSending.pop_front();
-				state[i] = 0;
+			
+			// Run the bit-plane kernel a packet at a time
+			g711Audio in[SAMPLES_PER_PACKET], out[SAMPLES_PER_PACKET];
+			unsigned long long bits[(SAMPLES_PER_PACKET + 63) / 64];
+			for (index_t done = 0; done < length; done += SAMPLES_PER_PACKET) {
+				length_t run = length - done;
+				if (run > SAMPLES_PER_PACKET) run = SAMPLES_PER_PACKET;
+				
+				bool law = untamperedSending.front().isAlaw() ? ALAW : ULAW;
+				for (index_t w = 0; w < (run + 63) / 64; w++) bits[w] = 0;
+				for (index_t i = 0; i < run; i++) {
+					in[i] = untamperedSending[i].transmissionSample();
+					bits[i / 64] |= (unsigned long long)(stegData[done + i] & 1) << (i % 64);
+				}
+				
+				lsbEmbed(law, in, bits, out, run);
+				
+				for (index_t i = 0; i < run; i++) {
+					samples[done + i] = G711Sample(law, out[i]);
+					state[done + i] = 0;
+				}
+				untamperedSending.erase(untamperedSending.begin(), untamperedSending.begin() + run);
 			}
 			return length;
 		}
@@ -100,11 +125,25 @@ class LSBStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 		length_t popRecoveredData(steg_t *stegData, length_t *bitLength, int *state, length_t length) {
 			length_t size = tamperedReceiving.size();
 			if (length > size) length = size;
-			for (index_t i = 0; i < length; i++) {
-				bitLength[i] = 1;
-				stegData[i] = tamperedReceiving.front().uninvertedSample() & 1;
-				state[i] = 0;
-				tamperedReceiving.pop_front();
+			
+			g711Audio in[SAMPLES_PER_PACKET];
+			unsigned long long bits[(SAMPLES_PER_PACKET + 63) / 64];
+			for (index_t done = 0; done < length; done += SAMPLES_PER_PACKET) {
+				length_t run = length - done;
+				if (run > SAMPLES_PER_PACKET) run = SAMPLES_PER_PACKET;
+				
+				bool law = tamperedReceiving.front().isAlaw() ? ALAW : ULAW;
+				for (index_t i = 0; i < run; i++)
+					in[i] = tamperedReceiving[i].transmissionSample();
+				
+				lsbExtract(law, in, bits, run);
+				
+				for (index_t i = 0; i < run; i++) {
+					bitLength[done + i] = 1;
+					stegData[done + i] = (bits[i / 64] >> (i % 64)) & 1;
+					state[done + i] = 0;
+				}
+				tamperedReceiving.erase(tamperedReceiving.begin(), tamperedReceiving.begin() + run);
 			}
 			return length;
 		}
@@ -113,6 +152,13 @@ class LSBStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 			tamperedReceiving.clear();
 		}
 		
+		// Each sample is tampered with on its own, using nothing else
+		bool isSampleIndependent() { return true; }
+		
+		// Every sample carries one bit, so there's no analysis to skip
+		// when given capacity records
+		std::string capacityKey() { return "lsb"; }
+		
 		// Inherited functions - InitOptions
 		error_t argp(int key, char *arg, struct argp_state *state) {
 			return ARGP_ERR_UNKNOWN;
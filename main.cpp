@@ -26,10 +26,28 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include ".class.hpp"
 #include "common/G711Sample.hpp"
 #include "common/FileBitProvider.hpp"
-#include "common/WorstNoiseBitProvider.hpp"
+#include "common/NoiseBitProvider.hpp"
+#include "common/RandomBitProvider.hpp"
+#include "common/EmbedPipeline.hpp"
+#include "common/SerialEmbedder.hpp"
+#include "common/BitPacker.hpp"
+#include "common/BitAssembler.hpp"
+#include "common/ChunkEmbedder.hpp"
+#include "common/MappedFile.hpp"
+#include "common/CapacitySidecar.hpp"
+#include "common/QualityMetrics.hpp"
+#include "common/LatencyHistogram.hpp"
+#include "common/CarrierFile.hpp"
+#include "common/PcapFile.hpp"
+#include "common/RtpStreams.hpp"
+#include "common/RtpProxy.hpp"
+#include "common/SessionManager.hpp"
 #include <iostream>
 #include <fstream>
-#include <queue>
+#include <deque>
+#include <chrono>
+#include <thread>
+#include <vector>
 #include <cstdlib>
 #include <string.h>
 
@@ -45,26 +63,79 @@ static const char *doc = "Test for G711 steganography techniques";
 #define WORST_INPUT_S_OPTION 'w'
 #define FILE_INPUT_L_OPTION "file"
 #define FILE_INPUT_S_OPTION 'f'
+#define BEST_INPUT_L_OPTION "best"
+#define BEST_INPUT_S_OPTION 'q'
+#define RANDOM_INPUT_L_OPTION "random"
+#define RANDOM_INPUT_S_OPTION 'r'
+#define ENVELOPE_L_OPTION "envelope"
+#define ENVELOPE_S_OPTION 'e'
 #define OUTPUT_L_OPTION "output"
 #define OUTPUT_S_OPTION 'o'
+#define CAPACITY_L_OPTION "capacity"
+#define CAPACITY_S_OPTION 'c'
 #define SUMMARY_L_OPTION "summary"
 #define SUMMARY_S_OPTION 's'
 #define DETAILED_L_OPTION "detailed"
 #define DETAILED_S_OPTION 'd'
+#define PACKETS_L_OPTION "packets"
+#define PACKETS_S_OPTION 'p'
+#define THREADS_L_OPTION "threads"
+#define THREADS_S_OPTION 't'
+#define VERIFY_L_OPTION "verify"
+#define VERIFY_S_OPTION 'v'
+#define PIPELINE_L_OPTION "pipeline"
+#define PIPELINE_S_OPTION 'P'
+#define CAPINDEX_L_OPTION "capindex"
+#define CAPINDEX_S_OPTION 'C'
+#define WAVE_L_OPTION "wave"
+#define WAVE_S_OPTION 'W'
+#define LINEAR_L_OPTION "linear"
+#define LINEAR_S_OPTION 'L'
+#define UDP_L_OPTION "udp"
+#define UDP_S_OPTION 'U'
+#define IDLE_L_OPTION "idle"
+#define IDLE_S_OPTION 'i'
+#define SESSIONS_L_OPTION "sessions"
+#define SESSIONS_S_OPTION 'S'
+#define BLOCK_L_OPTION "block"
+#define BLOCK_S_OPTION 'B'
 
 #define FILE_STR "FILE"
+#define COUNT_STR "COUNT"
+#define FRACTION_STR "FRACTION"
+#define SECONDS_STR "SECONDS"
+#define CALLS_STR "CALLS"
+#define SAMPLES_STR "SAMPLES"
+#define SEED_STR "SEED"
 
 static struct argp_option mainArgp_opts[] = {
 	// Group 0: What kind of audio:
 	{ALAW_L_OPTION, ALAW_S_OPTION, 0, 0, "Assume G711AUDIO is alaw stream (default)", 0},
 	{ULAW_L_OPTION, ULAW_S_OPTION, 0, 0, "Assume G711AUDIO is ulaw stream", 0},
+	{WAVE_L_OPTION, WAVE_S_OPTION, 0, 0, "Write OUTPUT as a WAV file when embedding (default if G711AUDIO is one, which also decides alaw or ulaw)", 0},
+	{LINEAR_L_OPTION, LINEAR_S_OPTION, 0, 0, "Write OUTPUT as a 16-bit PCM WAV file when embedding - for listening, as nothing can be extracted from it", 0},
 	// Group 1: Do what with the audio:
 	{WORST_INPUT_L_OPTION, WORST_INPUT_S_OPTION, 0, 0, "Embed G711AUDIO with worst-case noise scenario and write to OUTPUT (default)", 1},
 	{FILE_INPUT_L_OPTION, FILE_INPUT_S_OPTION, FILE_STR, 0, "Embed G711AUDIO with FILE and write to OUTPUT", 1},
+	{BEST_INPUT_L_OPTION, BEST_INPUT_S_OPTION, 0, 0, "Embed G711AUDIO with best-case noise scenario and write to OUTPUT", 1},
+	{RANDOM_INPUT_L_OPTION, RANDOM_INPUT_S_OPTION, SEED_STR, OPTION_ARG_OPTIONAL, "Embed G711AUDIO with random data from SEED (default 1) and write to OUTPUT", 1},
+	{ENVELOPE_L_OPTION, ENVELOPE_S_OPTION, SEED_STR, OPTION_ARG_OPTIONAL, "Embed G711AUDIO with the worst case, random data from SEED (default 1) and the best case in one pass, writing the worst case to OUTPUT and the noise-signal ratio of each to the summary", 1},
 	{OUTPUT_L_OPTION, OUTPUT_S_OPTION, 0, 0, "Extract to OUTPUT a file previously embedded into G711AUDIO", 1},
+	{CAPACITY_L_OPTION, CAPACITY_S_OPTION, 0, 0, "Report to OUTPUT how many bits G711AUDIO can hide, without embedding", 1},
 	// Group 2: Summary information:
 	{SUMMARY_L_OPTION, SUMMARY_S_OPTION, FILE_STR, 0, "Write a statistics summary to a file", 2},
 	{DETAILED_L_OPTION, DETAILED_S_OPTION, FILE_STR, 0, "Write detailed statistics to a file", 2},
+	// Group 3: Performance:
+	{PACKETS_L_OPTION, PACKETS_S_OPTION, COUNT_STR, 0, "Read and push COUNT packets of G711AUDIO at a time (default 1)", 3},
+	{BLOCK_L_OPTION, BLOCK_S_OPTION, SAMPLES_STR, 0, "Read and push SAMPLES samples of G711AUDIO at a time instead, as a live driver would to cut latency", 3},
+	{THREADS_L_OPTION, THREADS_S_OPTION, COUNT_STR, 0, "Let the algorithm use up to COUNT worker threads where it can (default 1); algorithms that split up each push, such as Neal's packets, need -p above 1 to have anything to split. Embedding a file (-f) with an algorithm whose samples don't depend on each other is instead split into chunks across the threads", 3},
+	{VERIFY_L_OPTION, VERIFY_S_OPTION, FRACTION_STR, 0, "Fully re-analyse the samples of FRACTION of the algorithm's pops (up to a packet each) when verifying, and trust its expectations for the rest (default 0.1)", 3},
+	{PIPELINE_L_OPTION, PIPELINE_S_OPTION, 0, 0, "Embed with reading, embedding, verifying and writing each on their own thread", 3},
+	{CAPINDEX_L_OPTION, CAPINDEX_S_OPTION, FILE_STR, OPTION_ARG_OPTIONAL, "Reuse the algorithm's analysis of G711AUDIO saved in FILE (default G711AUDIO.cap), saving it there first if needed", 3},
+	{SESSIONS_L_OPTION, SESSIONS_S_OPTION, CALLS_STR, 0, "Embed into CALLS simulated calls of G711AUDIO at once, sharded over -t threads, and report to OUTPUT how many calls a core can carry in real time", 3},
+	// Group 4: Live:
+	{UDP_L_OPTION, UDP_S_OPTION, 0, 0, "G711AUDIO and OUTPUT are IPv4 HOST:PORT[-LAST] addresses - relay RTP arriving at G711AUDIO on to OUTPUT, embedding into each stream; with -o, receive at G711AUDIO and extract each stream to OUTPUT.<ssrc>", 4},
+	{IDLE_L_OPTION, IDLE_S_OPTION, SECONDS_STR, 0, "With -U, stop once nothing has arrived for SECONDS (default 5)", 4},
 	{ 0 }
 };
 
@@ -74,11 +145,28 @@ typedef struct mainArgsS {
 	// Mutually exclusive options will result in a presented error
 	bool isAlaw;
 	bool isUlaw;
+	bool isWave;
+	bool isLinear;
 	bool isWorst;
 	char* embedFile;
+	bool isBest;
+	bool isRandom;
+	bool isEnvelope;
+	unsigned long long seed;
 	bool isOutput;
+	bool isCapacity;
 	char* summaryFile;
 	char* detailedFile;
+	length_t packets;
+	length_t block;
+	unsigned int threads;
+	double verifyFraction;
+	bool isPipeline;
+	bool isCapIndex;
+	char* capIndexFile;
+	length_t sessions;
+	bool isUdp;
+	double idleSeconds;
 	char* audioFile;
 	char* outputFile;
 } mainArgs;
@@ -92,7 +180,13 @@ void checkManip(struct argp_state *state, mainArgs *args) {
 	int inputs = 0, outputs = 0;
 	if (args->isWorst) inputs++;
 	if (args->embedFile) inputs++;
+	if (args->isBest) inputs++;
+	if (args->isRandom) inputs++;
+	if (args->isEnvelope) inputs++;
 	if (args->isOutput) outputs++;
+	if (args->isCapacity) outputs++;
+	if (outputs > 1)
+		argp_error(state, "can only extract data or report capacity, not both");
 	if (inputs && outputs)
 		argp_error(state, "cannot simultaneously embed and extract data from file");
 	if (inputs > 1)
@@ -110,6 +204,12 @@ error_t mainParser(int key, char *arg, struct argp_state *state) {
 			args->isUlaw = true;
 			checkLaw(state, args);
 			return 0;
+		case WAVE_S_OPTION:
+			args->isWave = true;
+			return 0;
+		case LINEAR_S_OPTION:
+			args->isLinear = true;
+			return 0;
 		case WORST_INPUT_S_OPTION:
 			args->isWorst = true;
 			checkManip(state, args);
@@ -121,10 +221,28 @@ error_t mainParser(int key, char *arg, struct argp_state *state) {
 			args->embedFile = arg;
 			checkManip(state, args);
 			return 0;
+		case BEST_INPUT_S_OPTION:
+			args->isBest = true;
+			checkManip(state, args);
+			return 0;
+		case RANDOM_INPUT_S_OPTION:
+			args->isRandom = true;
+			if (arg) args->seed = strtoull(arg, NULL, 0);
+			checkManip(state, args);
+			return 0;
+		case ENVELOPE_S_OPTION:
+			args->isEnvelope = true;
+			if (arg) args->seed = strtoull(arg, NULL, 0);
+			checkManip(state, args);
+			return 0;
 		case OUTPUT_S_OPTION:
 			args->isOutput = true;
 			checkManip(state, args);
 			return 0;
+		case CAPACITY_S_OPTION:
+			args->isCapacity = true;
+			checkManip(state, args);
+			return 0;
 		case SUMMARY_S_OPTION:
 			if (args->summaryFile) { // Already specified?
 				argp_usage(state);
@@ -137,6 +255,46 @@ error_t mainParser(int key, char *arg, struct argp_state *state) {
 			}
 			args->detailedFile = arg;
 			return 0;
+		case PACKETS_S_OPTION:
+			if (atoi(arg) < 1)
+				argp_error(state, "%s is not a valid packet count", arg);
+			args->packets = atoi(arg);
+			return 0;
+		case BLOCK_S_OPTION:
+			if (atoi(arg) < 1)
+				argp_error(state, "%s is not a valid block length", arg);
+			args->block = atoi(arg);
+			return 0;
+		case THREADS_S_OPTION:
+			if (atoi(arg) < 1)
+				argp_error(state, "%s is not a valid thread count", arg);
+			args->threads = atoi(arg);
+			return 0;
+		case VERIFY_S_OPTION:
+			args->verifyFraction = atof(arg);
+			if (args->verifyFraction < 0 || args->verifyFraction > 1)
+				argp_error(state, "%s is not a valid fraction - try 0-1", arg);
+			return 0;
+		case PIPELINE_S_OPTION:
+			args->isPipeline = true;
+			return 0;
+		case CAPINDEX_S_OPTION:
+			args->isCapIndex = true;
+			args->capIndexFile = arg;
+			return 0;
+		case SESSIONS_S_OPTION:
+			if (atoi(arg) < 1)
+				argp_error(state, "%s is not a valid call count", arg);
+			args->sessions = atoi(arg);
+			return 0;
+		case UDP_S_OPTION:
+			args->isUdp = true;
+			return 0;
+		case IDLE_S_OPTION:
+			args->idleSeconds = atof(arg);
+			if (args->idleSeconds <= 0)
+				argp_error(state, "%s is not a valid number of seconds", arg);
+			return 0;
 		case ARGP_KEY_ARG: // A non-option key - the audio file or output file
 			switch (state->arg_num) {
 				case 0: args->audioFile = arg; break;
@@ -148,22 +306,53 @@ error_t mainParser(int key, char *arg, struct argp_state *state) {
 			if ((!args->audioFile) || (!args->outputFile)) {
 				argp_usage(state);
 			}
+			if (args->block && (args->packets > 1))
+				argp_error(state, "packets and block length are mutually exclusive");
+			if (args->isPipeline && (args->isOutput || args->isCapacity))
+				argp_error(state, "pipeline mode only applies to embedding");
+			if (args->isCapIndex && args->isOutput)
+				argp_error(state, "a capacity index only applies to embedding or reporting capacity");
+			if ((args->isWave || args->isLinear) && (args->isOutput || args->isCapacity))
+				argp_error(state, "WAV output only applies to embedding");
+			if (args->isUdp && (args->isCapacity || args->detailedFile || args->isPipeline || args->isCapIndex || args->isWave || args->isLinear))
+				argp_error(state, "only embedding and extracting (without -d, -P, -C, -W or -L) can be done live");
+			if (args->sessions && (args->isOutput || args->isCapacity || args->detailedFile || args->isPipeline || args->isCapIndex || args->isWave || args->isLinear || args->isUdp))
+				argp_error(state, "simulated calls only apply to embedding (without -d, -P, -C, -W, -L or -U)");
+			if ((args->isBest || args->isRandom || args->isEnvelope) && (args->isUdp || args->sessions))
+				argp_error(state, "best-case, random and envelope payloads can't be used live or with simulated calls");
+			if (args->isEnvelope && (args->detailedFile || args->isPipeline))
+				argp_error(state, "an envelope can't be embedded with -d or -P");
 			return 0;
 		default:
 			return ARGP_ERR_UNKNOWN;
 	}
 }
 
-inline length_t readSamples(std::ifstream *fileIn, bool law, G711Sample *samplesOut) {
-	g711Audio audioIn[SAMPLES_PER_PACKET];
-	fileIn->read((char*)audioIn, SAMPLES_PER_PACKET);
-	
-	length_t count = fileIn->gcount();
-	
-	for (index_t i = 0; i < count; i++)
-		samplesOut[i] = G711Sample(law, audioIn[i]);
+// Each RTP stream in a capture gets its own copy of the algorithm
+G711StegAlgorithm* copyAlgorithm(G711StegAlgorithm *prototype) {
+	return new CLASS(*(CLASS*) prototype);
+}
+
+inline length_t readSamples(CarrierReader *carrier, bool law, G711Sample *samplesOut, length_t count) {
+	return carrier->read(law, samplesOut, count);
+}
+
+// Embeds on this thread with calls to the algorithm and bit source bound
+// statically, setting the totals given; returns false if verification failed
+template <class Bits>
+bool embedSerially(CLASS *g711steg, Bits *bitSource, CarrierReader *audio, bool law,
+	length_t readLength, CarrierWriter *writer, std::ofstream *detailed, bool statistics,
+	double verifyFraction, length_t *processedSamples, length_t *processedHiddenBits,
+	QualityMetrics *metrics, LatencyHistogram *latency) {
+	SerialEmbedder<CLASS, Bits> serial(g711steg, bitSource, audio, law, readLength,
+		writer, detailed, statistics, verifyFraction);
+	bool verified = serial.run();
 	
-	return count;
+	*processedSamples = serial.processedSamples;
+	*processedHiddenBits = serial.processedHiddenBits;
+	*metrics = serial.metrics;
+	*latency = serial.latency;
+	return verified;
 }
 
 int main(int argc, char **argv) {
@@ -171,11 +360,28 @@ int main(int argc, char **argv) {
 	mainArgs args;
 	args.isAlaw = false;
 	args.isUlaw = false;
+	args.isWave = false;
+	args.isLinear = false;
 	args.isWorst = false;
 	args.embedFile = NULL;
+	args.isBest = false;
+	args.isRandom = false;
+	args.isEnvelope = false;
+	args.seed = 1;
 	args.isOutput = false;
+	args.isCapacity = false;
 	args.summaryFile = NULL;
 	args.detailedFile = NULL;
+	args.packets = 1;
+	args.block = 0;
+	args.threads = 1;
+	args.verifyFraction = 0.1;
+	args.isPipeline = false;
+	args.isCapIndex = false;
+	args.capIndexFile = NULL;
+	args.sessions = 0;
+	args.isUdp = false;
+	args.idleSeconds = 5;
 	args.audioFile = NULL;
 	args.outputFile = NULL;
 	
@@ -183,22 +389,90 @@ int main(int argc, char **argv) {
 	argp_parse (&argParser, argc, argv, 0, 0, &args);
 	
 	// Set defaults for options not chosen
+	bool isLawChosen = args.isAlaw || args.isUlaw;
 	if ((!args.isAlaw) && (!args.isUlaw))
 		args.isAlaw = true;
 	
-	if ((!args.isWorst) && (!args.embedFile) && (!args.isOutput))
+	if ((!args.isWorst) && (!args.embedFile) && (!args.isBest) && (!args.isRandom) &&
+		(!args.isEnvelope) && (!args.isOutput) && (!args.isCapacity))
 		args.isWorst = true;
 	
+	g711steg.setWorkerThreads(args.threads);
+	
+	// Live RTP: there are no files to open, besides the summary
+	if (args.isUdp) {
+		RtpProxy proxy(&g711steg, copyAlgorithm, args.isOutput, args.embedFile,
+			args.outputFile, args.verifyFraction, args.summaryFile != NULL, args.idleSeconds);
+		if (!proxy.open(args.audioFile, args.isOutput ? NULL : args.outputFile))
+			return 1;
+		
+		std::ofstream summaryOut;
+		if (args.summaryFile) {
+			summaryOut.open(args.summaryFile, std::ios::out);
+			if (summaryOut.is_open())
+				std::cout << "[Main] Writing summary to " << args.summaryFile << std::endl;
+			else {
+				std::cout << "[Main] Couldn't open file " << args.summaryFile << std::endl;
+				return 1;
+			}
+		}
+		
+		bool verified = proxy.run();
+		proxy.report(&std::cout);
+		
+		if (args.summaryFile) {
+			if (!args.isOutput) {
+				summaryOut << "Average noise-signal ratio:\t" << std::fixed << proxy.metrics.meanNSR() << std::endl;
+				proxy.metrics.write(&summaryOut);
+			}
+			proxy.writeSummary(&summaryOut);
+			summaryOut << "Average hidden bitrate b/s:\t" << std::fixed <<
+				(proxy.processedHiddenBits / (proxy.processedSamples * 1.0 / SAMPLES_PER_SECOND)) << std::endl;
+			summaryOut.close();
+		}
+		
+		if (!verified) return 1;
+		std::cout << "[Main] Finished" << std::endl;
+		return 0;
+	}
+	
 	// Open audio file
-	std::ifstream audio;
-	audio.open(args.audioFile, std::ios::in | std::ios::binary);
-	if (audio.is_open())
-		std::cout << "[Main] File " << args.audioFile << " is " << (args.isAlaw ? "a" : "u") << "law" << std::endl;
-	else {
+	CarrierReader audio(args.audioFile);
+	if (!audio.isOpen()) {
 		std::cout << "[Main] Couldn't open file " << args.audioFile << std::endl;
 		return 1;
 	}
 	
+	// A capture has streams of either law, with their own headers
+	bool isCapture = PcapReader::isPcap(audio.data(), audio.size());
+	if (isCapture) {
+		if (args.isCapacity || args.detailedFile || args.isPipeline || args.isCapIndex || args.isWave || args.isLinear || args.sessions) {
+			std::cout << "[Main] Only embedding and extracting (without -d, -P, -C, -W, -L or -S) can be done with a capture" << std::endl;
+			return 1;
+		}
+		if (args.isBest || args.isRandom || args.isEnvelope) {
+			std::cout << "[Main] A capture can only be embedded with FILE or the worst case" << std::endl;
+			return 1;
+		}
+		std::cout << "[Main] File " << args.audioFile << " is a pcap capture" << std::endl;
+	} else {
+		// A WAV file says which law it uses
+		if (audio.isWave()) {
+			if (!WaveFile::isG711(audio.wave())) {
+				std::cout << "[Main] File " << args.audioFile << " is a WAV file, but not mono alaw or ulaw" << std::endl;
+				return 1;
+			}
+			
+			bool isWaveUlaw = (audio.wave().format == WAVE_FORMAT_MULAW);
+			if (isLawChosen && (isWaveUlaw != args.isUlaw))
+				std::cout << "[Main] Using the law in the WAV header instead" << std::endl;
+			args.isUlaw = isWaveUlaw;
+			args.isAlaw = !isWaveUlaw;
+		}
+		std::cout << "[Main] File " << args.audioFile << " is " << (args.isAlaw ? "a" : "u") << "law"
+			<< (audio.isWave() ? " in a WAV file" : "") << std::endl;
+	}
+	
 	// Open output file	
 	std::ofstream output;
 	output.open(args.outputFile, std::ios::out | std::ios::binary);
@@ -240,189 +514,390 @@ int main(int argc, char **argv) {
 	// Read audio and process it
 	bool law = args.isAlaw ? ALAW : ULAW;
 	
+	// Use the algorithm's saved analysis of the audio, saving it first if need be
+	CapacitySidecar sidecar;
+	if (args.isCapIndex) {
+		std::string sidecarFile = args.capIndexFile ? args.capIndexFile : std::string(args.audioFile) + ".cap";
+		std::string key = g711steg.capacityKey();
+		
+		if (key.empty()) {
+			std::cout << "[Main] Capacity index not supported with these options, ignored" << std::endl;
+		} else if (sidecar.open(sidecarFile.c_str(), key, law, audio.data(), audio.size())) {
+			std::cout << "[Main] Using capacity index " << sidecarFile << std::endl;
+		} else {
+			std::cout << "[Main] Building capacity index " << sidecarFile << std::endl;
+			
+			// Built by a copy of the algorithm, made before anything has been pushed
+			CLASS builder(g711steg);
+			std::vector<capacityRecord> records;
+			CapacitySidecar::build(&builder, law, audio.data(), audio.size(), &records);
+			
+			if ((!CapacitySidecar::write(sidecarFile.c_str(), key, law, audio.data(), audio.size(), records)) ||
+				(!sidecar.open(sidecarFile.c_str(), key, law, audio.data(), audio.size())))
+					std::cout << "[Main] Couldn't write capacity index " << sidecarFile << std::endl;
+		}
+		
+		if (sidecar.records())
+			g711steg.useCapacityRecords(sidecar.records());
+	}
+	
 	index_t sampleIndex;
 	length_t sampleCount;
-	G711Sample samples[SAMPLES_PER_PACKET];
+	length_t readLength = args.block ? args.block : SAMPLES_PER_PACKET * args.packets;
+	// Popped samples go back in the same buffer, and an algorithm may pop up to a packet at once
+	std::vector<G711Sample> samplesBuffer(readLength > SAMPLES_PER_PACKET ? readLength : SAMPLES_PER_PACKET);
+	G711Sample *samples = &samplesBuffer[0];
 	
 	steg_t hiddenData[SAMPLES_PER_PACKET];
 	length_t hiddenDataLength[SAMPLES_PER_PACKET];
-	steg_t hiddenDataMask;
-	index_t hiddenDataBitIndex;
 	
 	length_t processedSamples = 0;
-	std::queue<G711Sample> originals;
 	
 	length_t processedHiddenBits = 0;
 	
-	int state[SAMPLES_PER_PACKET];
+	int state[SAMPLES_PER_PACKET] = { 0 };
 	
-	if (args.isOutput) { // Output a file hidden in the audio
-		unsigned char thisByte = 0, byteMask = 1;
-	
-		while (sampleCount = readSamples(&audio, law, samples)) {
-			// For statistics
-			for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++)
-				originals.push(samples[sampleIndex]);
+	if (args.isCapacity) { // Report how much could be hidden in the audio
+		unsigned long long capacity = 0;
+		steg_t noData[SAMPLES_PER_PACKET] = { 0 };
+		
+		while ((sampleCount = readSamples(&audio, law, samples, readLength))) {
+			g711steg.pushUntamperedSamples(samples, sampleCount);
+			capacity += g711steg.bitsAvailableTotal();
+			
+			// Nothing is embedded, but the samples are still popped so the
+			// algorithm moves on exactly as it would have while embedding
+			while ((sampleCount = g711steg.untamperedSamplesReadyForPop())) {
+				if (sampleCount > SAMPLES_PER_PACKET) sampleCount = SAMPLES_PER_PACKET;
+				sampleCount = g711steg.popTamperedSamples(samples, noData, state, sampleCount);
+				if (!sampleCount) break;
+				processedSamples += sampleCount;
+			}
+		}
+		
+		output << capacity << std::endl;
+		std::cout << "[Main] Capacity: " << capacity << " bits in "
+			<< processedSamples << " samples" << std::endl;
+		processedHiddenBits = capacity;
+	} else if (args.sessions) { // Time many calls at once through the session manager
+		SessionManager manager(&g711steg, copyAlgorithm, args.embedFile, args.verifyFraction,
+			args.summaryFile != NULL, args.threads);
+		length_t packets = (audio.size() + SAMPLES_PER_PACKET - 1) / SAMPLES_PER_PACKET;
+		length_t remaining = args.sessions; // Calls not yet seen to end
+		sessionPacket returned;
+		
+		std::cout << "[Main] Running " << args.sessions << " calls of " << packets << " packets on "
+			<< manager.shardCount() << " shards" << std::endl;
+		manager.start();
+		std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+		
+		// Every call plays the whole audio, each starting somewhere else,
+		// a packet per call in turn; whatever comes back is thrown away
+		for (index_t tick = 0; (tick < packets) && (!manager.isFailed()); tick++) {
+			for (callId call = 0; call < args.sessions; call++) {
+				index_t offset = ((tick + call * 37) % packets) * SAMPLES_PER_PACKET;
+				length_t count = audio.size() - offset;
+				if (count > SAMPLES_PER_PACKET) count = SAMPLES_PER_PACKET;
+				
+				while ((!manager.push(call, law, audio.data() + offset, count)) && (!manager.isFailed()))
+					while (manager.pop(&returned))
+						if (!returned.length) remaining--;
+			}
+			while (manager.pop(&returned))
+				if (!returned.length) remaining--;
+		}
+		for (callId call = 0; call < args.sessions; call++)
+			while ((!manager.end(call)) && (!manager.isFailed()))
+				while (manager.pop(&returned))
+					if (!returned.length) remaining--;
+		while (remaining && (!manager.isFailed())) {
+			if (!manager.pop(&returned)) std::this_thread::yield();
+			else if (!returned.length) remaining--;
+		}
+		
+		std::chrono::duration<double> wall = std::chrono::steady_clock::now() - started;
+		manager.stop();
+		manager.report(&std::cout);
+		
+		processedSamples = manager.processedSamples;
+		processedHiddenBits = manager.processedHiddenBits;
+		
+		if (manager.isFailed()) {
+			audio.close();
+			output.close();
+			if (args.summaryFile) summaryOut.close();
+			return 1;
+		}
+		
+		// Calls one core could keep up with, going by the time the shards
+		// were busy, and by the time taken overall
+		double callSeconds = audio.size() * 1.0 / SAMPLES_PER_SECOND;
+		double perCoreBusy = args.sessions * callSeconds / manager.processingSeconds;
+		double perCoreWall = args.sessions * callSeconds / (wall.count() * manager.shardCount());
+		std::cout << "[Main] " << args.sessions << " calls of " << callSeconds << " s in " << wall.count()
+			<< " s: " << perCoreBusy << " calls per core in real time (" << perCoreWall << " by elapsed time)" << std::endl;
+		output << "Calls per core in real time:\t" << perCoreBusy << std::endl;
+		output << "Calls per core in real time, by elapsed time:\t" << perCoreWall << std::endl;
+		
+		if (args.summaryFile)
+			summaryOut << "Average noise-signal ratio:\t" << std::fixed << manager.noise.meanNSR() << std::endl;
+	} else if (args.isOutput && isCapture) { // Output the files hidden in each stream of a capture
+		RtpStreams rtp(&g711steg, copyAlgorithm, audio.data(), audio.size(), NULL,
+			NULL, args.outputFile, args.verifyFraction, false);
+		bool extracted = rtp.run(args.threads);
+		rtp.report(&std::cout);
+		rtp.report(&output);
+		
+		processedSamples = rtp.processedSamples;
+		processedHiddenBits = rtp.processedHiddenBits;
+		
+		if (!extracted) {
+			audio.close();
+			output.close();
+			if (args.summaryFile) summaryOut.close();
+			return 1;
+		}
+	} else if (args.isOutput) { // Output a file hidden in the audio
+		BitAssembler extracted(&output);
+		
+		// Only the details show the samples, so only keep them for those
+		std::deque<G711Sample> originals;
+		
+		while ((sampleCount = readSamples(&audio, law, samples, readLength))) {
+			if (args.detailedFile) originals.insert(originals.end(), samples, samples + sampleCount);
 			
 			g711steg.pushTamperedSamples(samples, sampleCount);
-			while (sampleCount = g711steg.recoveredDataReadyForPop()) {
+			while ((sampleCount = g711steg.recoveredDataReadyForPop())) {
 				if (sampleCount > SAMPLES_PER_PACKET) sampleCount = SAMPLES_PER_PACKET;
 				sampleCount = g711steg.popRecoveredData(hiddenData, hiddenDataLength, state, sampleCount);
 				if (!sampleCount) break;
-				for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
-					processedSamples++;
-					if (args.detailedFile) {
-						detailedOut << processedSamples << "\t";
+				if (args.detailedFile) {
+					for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
+						detailedOut << (processedSamples + sampleIndex + 1) << "\t";
 						detailedOut << "n/a\t";
 						detailedOut << state[sampleIndex] << "\t";
-						detailedOut << originals.front().uninvertedSignedSample() << "\t";
+						detailedOut << originals[sampleIndex].uninvertedSignedSample() << "\t";
 						detailedOut << (hiddenData[sampleIndex] & ((1 << hiddenDataLength[sampleIndex]) - 1)) << "\t";
 						detailedOut << hiddenDataLength[sampleIndex] << "\t";
 						detailedOut << "n/a" << std::endl;
 					}
-					originals.pop();
-					
-					for (hiddenDataBitIndex = 0, hiddenDataMask = 1;
-						hiddenDataBitIndex < hiddenDataLength[sampleIndex];
-						hiddenDataBitIndex++, hiddenDataMask <<= 1) {
-							processedHiddenBits++;
-							if (hiddenData[sampleIndex] & hiddenDataMask) thisByte |= byteMask;
-							byteMask <<= 1;
-							if (!byteMask) {
-								// A full byte has been collected, push it out
-								byteMask = 1;
-								output.put((char) thisByte);
-								thisByte = 0;
-							}
-						}
+					originals.erase(originals.begin(), originals.begin() + sampleCount);
 				}
+				processedSamples += sampleCount;
+				
+				gatherBits(hiddenData, hiddenDataLength, sampleCount,
+					[&](unsigned long long bits, length_t bitCount) {
+						processedHiddenBits += bitCount;
+						extracted.append(bits, bitCount);
+					});
 			}
 		}
+		
+		extracted.flush();
 	} else { // Add data into the audio
-		BitProvider *bitSource;
-		if (args.isWorst)
-			bitSource = new WorstNoiseBitProvider(&g711steg);
-		else
-			bitSource = new FileBitProvider(args.embedFile);
+		// Streams in a capture each have their own
+		// Also kept as their own types, for embedding serially
+		BitProvider *bitSource = NULL;
+		BasicWorstNoiseBitProvider<CLASS> *worstBits = NULL;
+		BasicBestNoiseBitProvider<CLASS> *bestBits = NULL;
+		RandomBitProvider *randomBits = NULL;
+		FileBitProvider *fileBits = NULL;
+		if (!isCapture) {
+			if (args.isWorst || args.isEnvelope)
+				bitSource = worstBits = new BasicWorstNoiseBitProvider<CLASS>(&g711steg);
+			else if (args.isBest)
+				bitSource = bestBits = new BasicBestNoiseBitProvider<CLASS>(&g711steg);
+			else if (args.isRandom)
+				bitSource = randomBits = new RandomBitProvider(args.seed);
+			else
+				bitSource = fileBits = new FileBitProvider(args.embedFile);
+		}
+		
+		// Written raw, or as a WAV file
+		unsigned short outputFormat = 0;
+		if (args.isLinear)
+			outputFormat = WAVE_FORMAT_PCM;
+		else if (args.isWave || audio.isWave())
+			outputFormat = (law == ULAW) ? WAVE_FORMAT_MULAW : WAVE_FORMAT_ALAW;
+		CarrierWriter writer(&output, outputFormat);
 		
-		// For future verification and statistics
-		std::queue<steg_t> verifyEmbedData;
-		std::queue<length_t> verifyEmbedLength;
-		steg_t expData, actData;
-		length_t expLen, actLen;
+		// Statistics
+		QualityMetrics metrics;
+		LatencyHistogram latency;
+		double bestNSR = 0, randomNSR = 0;
 		
-		G711Sample thisOriginal, thisModified;
-		linearAudio noise, signal;
-		double thisNSR, NSRsum;
+		// Algorithms without state between samples can have their chunks
+		// embedded separately, so split the work up when allowed to
+		bool isChunked = (args.threads > 1) && (args.embedFile) && (!args.detailedFile) &&
+			(!args.isPipeline) && (g711steg.isSampleIndependent());
+		
+		if (isCapture) {
+			// The capture is copied to OUTPUT with the payloads of every
+			// stream tampered with in place
+			MappedOutputFile rewritten(args.outputFile, audio.size());
+			RtpStreams rtp(&g711steg, copyAlgorithm, audio.data(), audio.size(), rewritten.data(),
+				args.embedFile, NULL, args.verifyFraction, args.summaryFile != NULL);
+			bool verified = (rewritten.isOpen()) && (rtp.run(args.threads));
+			rtp.report(&std::cout);
 			
-		while ((sampleCount = readSamples(&audio, law, samples)) && (bitSource->remainingBits())) {
-			// For statistics
-			for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++)
-				originals.push(samples[sampleIndex]);
+			processedSamples = rtp.processedSamples;
+			processedHiddenBits = rtp.processedHiddenBits;
+			metrics = rtp.metrics;
 			
-			g711steg.pushUntamperedSamples(samples, sampleCount);
-			while ((g711steg.untamperedSamplesReadyForPop()) && (bitSource->remainingBits())) {
-				
-				sampleCount = g711steg.minimumSamplesForPop();
-				if (sampleCount > SAMPLES_PER_PACKET) {
-					std::cout << "[Main] Buffer length exceeded for algorithm minimum" << std::endl;
-					audio.close();
-					output.close();
-					if (args.summaryFile) summaryOut.close();
-					if (args.detailedFile) detailedOut.close();
-				}
-				
-				// Keep in mind we're doing the minimum number of samples for a successful pop.
-				// There might be a few extra 0 bits at the end of the file as a result.
-				// The alternative would be to add the check for remaining bits to this for loop -
-				// but then we'd not finish working on the samples and the end of the file would
-				// be cut off.
-				for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
-					hiddenDataMask = 1;
-					hiddenDataLength[sampleIndex] = g711steg.bitsAvailableForEncode(sampleIndex);
-					hiddenData[sampleIndex] = 0;
-					for (hiddenDataBitIndex = 0; hiddenDataBitIndex < hiddenDataLength[sampleIndex]; hiddenDataBitIndex++) {
-						processedHiddenBits++;
-						if (bitSource->nextBit()) hiddenData[sampleIndex] |= hiddenDataMask;
-						hiddenDataMask <<= 1;
-					}
-					
-					// For later verification
-					verifyEmbedData.push(hiddenData[sampleIndex]);
-					verifyEmbedLength.push(hiddenDataLength[sampleIndex]);
-				}
-				
-				sampleCount = g711steg.popTamperedSamples(samples, hiddenData, state, sampleCount);
-				
-				// Write out new samples, do statistics
-				for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
-					thisOriginal = originals.front();
-					originals.pop();
-					thisModified = samples[sampleIndex];
-					
-					output.put((char) thisModified.transmissionSample());
-					
-					noise = thisOriginal.linearDifference(thisModified);
-					signal = thisOriginal.linearSample();
-					thisNSR = (1.0 * noise / signal);
-					thisNSR *= thisNSR;
-					NSRsum += thisNSR;
-					processedSamples++;
-					
-					if (args.detailedFile) {
-						detailedOut << processedSamples << "\t";
-						detailedOut << thisOriginal.uninvertedSignedSample() << "\t";
-						detailedOut << state[sampleIndex] << "\t";
-						detailedOut << thisModified.uninvertedSignedSample() << "\t";
-						detailedOut << (hiddenData[sampleIndex] & ((1 << hiddenDataLength[sampleIndex]) - 1)) << "\t";
-						detailedOut << hiddenDataLength[sampleIndex] << "\t";
-						detailedOut << thisNSR << std::endl;
-					}
-				}
-				
-				// Verify embedded data
-				g711steg.pushTamperedSamples(samples, sampleCount);
-				
-				sampleCount = g711steg.recoveredDataReadyForPop();
-				sampleCount = g711steg.popRecoveredData(hiddenData, hiddenDataLength, state, sampleCount);
-				
-				for (sampleIndex = 0; sampleIndex < sampleCount; sampleIndex++) {
-					expData = verifyEmbedData.front();
-					verifyEmbedData.pop();
-					actData = hiddenData[sampleIndex];
-					
-					expLen = verifyEmbedLength.front();
-					verifyEmbedLength.pop();
-					actLen = hiddenDataLength[sampleIndex];
-					
-					if (expLen != actLen) {
-						std::cout << "[Main] Corruption detected: expected length "
-							<< expLen << "; got length " << actLen << std::endl;
-						audio.close();
-						output.close();
-						if (args.summaryFile) summaryOut.close();
-						if (args.detailedFile) detailedOut.close();
-						return 1;
-					} else {
-						hiddenDataMask = (1 << expLen) - 1;
-						expData &= hiddenDataMask;
-						actData &= hiddenDataMask;
-						if (expData != actData) {
-							std::cout << "[Main] Corruption detected: expected data "
-								<< expData << "; got data " << actData << std::endl;
-							audio.close();
-							output.close();
-							if (args.summaryFile) summaryOut.close();
-							if (args.detailedFile) detailedOut.close();
-							return 1;
-						}
-					}
-				}
+			if (!verified) {
+				audio.close();
+				output.close();
+				if (args.summaryFile) summaryOut.close();
+				return 1;
+			}
+		} else if (isChunked) {
+			MappedFile payload(args.embedFile);
+			
+			// The workers write samples through their own descriptor, so
+			// the header must be out of the stream's buffer first; the
+			// stream is only used again by writer.finish(), once they and
+			// the descriptor are done
+			output.flush();
+			int outputFd = open(args.outputFile, O_WRONLY);
+			
+			// Each worker gets its own copy of the algorithm, made before
+			// anything has been pushed
+			std::vector<CLASS> instances(args.threads, g711steg);
+			std::vector<G711StegAlgorithm*> workers;
+			for (index_t i = 0; i < instances.size(); i++) {
+				// Workers don't start at the first sample, so can't follow
+				// capacity records (not that these algorithms need them)
+				instances[i].useCapacityRecords(NULL);
+				workers.push_back(&instances[i]);
+			}
+			
+			length_t chunkLength = readLength;
+			if (chunkLength < SAMPLES_PER_PACKET * CHUNK_MIN_PACKETS)
+				chunkLength = SAMPLES_PER_PACKET * CHUNK_MIN_PACKETS;
+			// Whole quality frames, so the chunks' metrics can be merged
+			chunkLength = (chunkLength + QUALITY_FRAME_LENGTH - 1) / QUALITY_FRAME_LENGTH * QUALITY_FRAME_LENGTH;
+			std::cout << "[Main] Embedding in chunks of " << chunkLength << " samples on "
+				<< args.threads << " threads" << std::endl;
+			
+			ChunkEmbedder chunked(workers, audio.data(), audio.size(), law,
+				payload.data(), payload.size(), outputFd, &writer, chunkLength, readLength,
+				args.summaryFile != NULL);
+			bool verified = (outputFd >= 0) && (payload.isOpen()) && (chunked.run());
+			if (outputFd >= 0) close(outputFd);
+			
+			processedSamples = chunked.processedSamples;
+			processedHiddenBits = chunked.processedHiddenBits;
+			metrics = chunked.metrics;
+			latency = chunked.latency;
+			
+			if (!verified) {
+				audio.close();
+				output.close();
+				if (args.summaryFile) summaryOut.close();
+				return 1;
+			}
+		} else if (args.isPipeline) {
+			// The verifier gets its own copy of the algorithm, made before
+			// anything has been pushed to either
+			CLASS verifier(g711steg);
+			EmbedPipeline pipeline(&g711steg, &verifier, bitSource, &audio, law,
+				readLength, readSamples, &writer, args.detailedFile ? &detailedOut : NULL,
+				args.summaryFile != NULL);
+			bool verified = pipeline.run();
+			pipeline.report(&std::cout);
+			
+			processedSamples = pipeline.processedSamples;
+			processedHiddenBits = pipeline.processedHiddenBits;
+			metrics = pipeline.metrics;
+			latency = pipeline.latency;
+			
+			if (!verified) {
+				audio.close();
+				output.close();
+				if (args.summaryFile) summaryOut.close();
+				if (args.detailedFile) detailedOut.close();
+				return 1;
+			}
+		} else if (args.isEnvelope) {
+			// The other payloads get their own copies of the algorithm,
+			// made before anything has been pushed, and only keep statistics
+			CLASS randomSteg(g711steg), bestSteg(g711steg);
+			RandomBitProvider envelopeRandomBits(args.seed);
+			BasicBestNoiseBitProvider<CLASS> envelopeBestBits(&bestSteg);
+			SerialEmbedder<CLASS, BasicWorstNoiseBitProvider<CLASS> > worst(&g711steg, worstBits,
+				&audio, law, readLength, &writer, NULL, true, args.verifyFraction);
+			SerialEmbedder<CLASS, RandomBitProvider> random(&randomSteg, &envelopeRandomBits,
+				&audio, law, readLength, NULL, NULL, true, args.verifyFraction);
+			SerialEmbedder<CLASS, BasicBestNoiseBitProvider<CLASS> > best(&bestSteg, &envelopeBestBits,
+				&audio, law, readLength, NULL, NULL, true, args.verifyFraction);
+			
+			// One pass over the audio for all three
+			bool verified = true;
+			while ((verified) && (sampleCount = readSamples(&audio, law, samples, readLength)))
+				verified = (worst.embed(samples, sampleCount)) && (random.embed(samples, sampleCount)) &&
+					(best.embed(samples, sampleCount));
+			
+			processedSamples = worst.processedSamples;
+			processedHiddenBits = worst.processedHiddenBits;
+			metrics = worst.metrics;
+			latency = worst.latency;
+			metrics.finish();
+			best.metrics.finish();
+			random.metrics.finish();
+			bestNSR = best.metrics.meanNSR();
+			randomNSR = random.metrics.meanNSR();
+			std::cout << "[Main] Noise-signal ratio envelope: best " << bestNSR << ", random "
+				<< randomNSR << ", worst " << metrics.meanNSR() << std::endl;
+			
+			if (!verified) {
+				audio.close();
+				output.close();
+				if (args.summaryFile) summaryOut.close();
+				return 1;
+			}
+		} else {
+			// Statistics only go to the summary and details, so with neither
+			// the loop needn't keep or decode the original samples
+			std::ofstream *detailed = args.detailedFile ? &detailedOut : NULL;
+			bool statistics = (args.summaryFile != NULL);
+			bool verified;
+			if (worstBits)
+				verified = embedSerially(&g711steg, worstBits, &audio, law, readLength, &writer, detailed,
+					statistics, args.verifyFraction, &processedSamples, &processedHiddenBits, &metrics, &latency);
+			else if (bestBits)
+				verified = embedSerially(&g711steg, bestBits, &audio, law, readLength, &writer, detailed,
+					statistics, args.verifyFraction, &processedSamples, &processedHiddenBits, &metrics, &latency);
+			else if (randomBits)
+				verified = embedSerially(&g711steg, randomBits, &audio, law, readLength, &writer, detailed,
+					statistics, args.verifyFraction, &processedSamples, &processedHiddenBits, &metrics, &latency);
+			else
+				verified = embedSerially(&g711steg, fileBits, &audio, law, readLength, &writer, detailed,
+					statistics, args.verifyFraction, &processedSamples, &processedHiddenBits, &metrics, &latency);
+			
+			if (!verified) {
+				audio.close();
+				output.close();
+				if (args.summaryFile) summaryOut.close();
+				if (args.detailedFile) detailedOut.close();
+				return 1;
 			}
 		}
 		
+		writer.finish(processedSamples);
+		
 		// Final stats
-		if (args.summaryFile) summaryOut << "Average noise-signal ratio:\t" << std::fixed << (NSRsum / processedSamples) << std::endl;
+		if (args.summaryFile) {
+			metrics.finish();
+			summaryOut << "Average noise-signal ratio:\t" << std::fixed << metrics.meanNSR() << std::endl;
+			metrics.write(&summaryOut);
+			summaryOut << "Algorithm latency ms:\t" << (g711steg.latencySamples() * 1000.0 / SAMPLES_PER_SECOND) << std::endl;
+			latency.write(&summaryOut);
+			if (args.isEnvelope) {
+				summaryOut << "Envelope best-case noise-signal ratio:\t" << bestNSR << std::endl;
+				summaryOut << "Envelope random noise-signal ratio:\t" << randomNSR << std::endl;
+				summaryOut << "Envelope worst-case noise-signal ratio:\t" << metrics.meanNSR() << std::endl;
+			}
+		}
 		
 		delete bitSource;
 	}
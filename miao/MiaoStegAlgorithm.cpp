@@ -172,12 +172,31 @@ length_t MiaoStegAlgorithm::bitsAvailableForEncode(index_t index) {
 	return it->bitCount.at(whichItem - (whichItem > mid() ? 1 : 0));
 }
 
+// One walk of the groups, rather than one per sample
+void MiaoStegAlgorithm::capacities(length_t *out, length_t count) {
+	processedList::iterator it = untamperedProcessed.begin();
+	index_t i = 0;
+	
+	for (; (i < count) && (it != untamperedProcessed.end()); it++) {
+		for (index_t item = 0; (item < n()) && (i < count); item++, i++) {
+			if ((item == mid()) || (it->bitCount.empty()))
+				out[i] = 0;
+			else
+				out[i] = it->bitCount.at(item - (item > mid() ? 1 : 0));
+		}
+	}
+	
+	for (; i < count; i++) out[i] = 0;
+}
+
 length_t MiaoStegAlgorithm::popTamperedSamples(G711Sample *samples, const steg_t *stegData, int *state, length_t length) {
 	length_t size = untamperedSamplesReadyForPop();
 	if (length > size) length = size;
 	
 	length /= n();
 	
+	lastPopped.clear();
+	
 	for (index_t i = 0; i < length; i++) {
 		if (!untamperedProcessed.front().bitCount.empty()) {
 			int mu = untamperedProcessed.front().mu;
@@ -198,7 +217,7 @@ length_t MiaoStegAlgorithm::popTamperedSamples(G711Sample *samples, const steg_t
 		
 		for (index_t s = 0; s < n(); s++) samples[i*n()+s] = untamperedProcessed.front().samples.at(s);
 		
-		untamperedProcessed.pop_front();
+		lastPopped.splice(lastPopped.end(), untamperedProcessed, untamperedProcessed.begin());
 	}
 	
 	length *= n();
@@ -216,6 +235,30 @@ void MiaoStegAlgorithm::pushTamperedSamples(const G711Sample *samples, length_t
 	process(&tamperedUnprocessed, &tamperedProcessed);
 }
 
+void MiaoStegAlgorithm::pushTamperedSamplesExpected(const G711Sample *samples, length_t length) {
+	// Only whole groups, lined up with the groups popped, can be reused
+	if ((!tamperedUnprocessed.empty()) || (length != lastPopped.size() * n())) {
+		pushTamperedSamples(samples, length);
+		return;
+	}
+	
+	// Tampering keeps the sum of a group, so its mean, group deltas and
+	// bit counts are as they were; only the deltas need working out again
+	index_t midv = mid();
+	for (processedList::iterator it = lastPopped.begin(); it != lastPopped.end(); it++, samples += n()) {
+		MiaoG711SampleGroup staging;
+		staging.mu = it->mu;
+		staging.groupDelta = it->groupDelta;
+		staging.bitCount = it->bitCount;
+		staging.samples.assign(samples, samples + n());
+		for (index_t i = 0; i < n(); i++)
+			if (i != midv)
+				staging.deltas.push_back(staging.mu - samples[i].uninvertedSignedSample());
+		tamperedProcessed.push_back(staging);
+	}
+	lastPopped.clear();
+}
+
 length_t MiaoStegAlgorithm::recoveredDataReadyForPop() {
 	return tamperedProcessed.size()*n();
 }
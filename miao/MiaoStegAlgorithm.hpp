@@ -47,14 +47,17 @@ typedef struct miaoGroupS {
 	length_t bitsAllowed;
 } miaoGroup;
 
-class MiaoStegAlgorithm : public G711StegAlgorithm, public InitOptions {
+class MiaoStegAlgorithm final : public G711StegAlgorithm, public InitOptions {
 	friend error_t miaoParser(int key, char *arg, struct argp_state *state);
+	template <class Algo> friend steg_t getNoisiestExtremePatternOnly(index_t index, Algo *on);
 	
 	private:
 		static MiaoStegAlgorithm *lastArgp;
 		static miaoGroup groups[];
 		unprocessedList untamperedUnprocessed, tamperedUnprocessed;
 		processedList untamperedProcessed, tamperedProcessed;
+		// The groups popped by the last popTamperedSamples call
+		processedList lastPopped;
 		length_t k;
 		g711Audio maxLambda;
 		
@@ -80,13 +83,18 @@ class MiaoStegAlgorithm : public G711StegAlgorithm, public InitOptions {
 		virtual length_t untamperedSamplesReadyForPop();
 		virtual length_t minimumSamplesForPop();
 		virtual length_t bitsAvailableForEncode(index_t index);
+		virtual void capacities(length_t *out, length_t count);
 		virtual length_t popTamperedSamples(G711Sample *samples, const steg_t *stegData, int *state, length_t length);
 		virtual void resetUntampered();
 		virtual void pushTamperedSamples(const G711Sample *samples, length_t length);
+		virtual void pushTamperedSamplesExpected(const G711Sample *samples, length_t length);
 		virtual length_t recoveredDataReadyForPop();
 		virtual length_t popRecoveredData(steg_t *stegData, length_t *bitLength, int *state, length_t length);
 		virtual void resetTampered();
 		
+		// A group can't be tampered with until all of it is in
+		virtual length_t latencySamples() { return n() - 1; }
+		
 		// Inherited functions - InitOptions
 		error_t argp(int key, char *arg, struct argp_state *state);
 		virtual struct argp_child* getArgp();
@@ -32,6 +32,8 @@ The authors of the above mentioned paper do not endorse this work.
 #include <argp.h>
 #include <vector>
 #include <cstdlib>
+#include <cstdio>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include "../../common/G711Sample.hpp"
@@ -42,12 +44,29 @@ The authors of the above mentioned paper do not endorse this work.
 #define LOW_K_KEY 'l'
 #define HIGH_K_OPTION "upperk"
 #define HIGH_K_KEY 'u'
+#define CONFIDENCE_OPTION "confidence"
+#define CONFIDENCE_KEY 'c'
+#define EMBEDDED_RATE_OPTION "embeddedrate"
+#define EMBEDDED_RATE_KEY 'p'
+#define CLEAN_RATE_OPTION "cleanrate"
+#define CLEAN_RATE_KEY 'q'
+#define LAMBDA_OPTION "lambda"
+#define LAMBDA_KEY 'm'
+#define FULL_SCAN_OPTION "full"
+#define FULL_SCAN_KEY 'f'
 
 static const char *miaoArgsDoc = "G711-ALAW-AUDIO";
-static const char *miaoDoc = "Naive search for Miao/Huang-encoded audio";
+static const char *miaoDoc = "Naive search for Miao/Huang-encoded audio\v"
+	"Every k and window offset is treated as a hypothesis and tested with a "
+	"sequential probability ratio test as the file is read. A hypothesis is "
+	"dropped once its hit rate is inconsistent with Miao embedding, and the "
+	"search stops as soon as one hypothesis is confirmed (unless --full).";
 
 typedef struct miaoDetectArgsS {
 	unsigned int lowK, highK;
+	double confidence, embeddedRate, cleanRate;
+	int lambda;
+	bool fullScan;
 	char* audioFile;
 } miaoDetectArgs;
 
@@ -60,6 +79,29 @@ error_t miaoDetectParser (int key, char *arg, struct argp_state *state) {
 		case HIGH_K_KEY:
 			args->highK = atoi(arg);
 			return 0;
+		case CONFIDENCE_KEY:
+			args->confidence = atof(arg);
+			if (args->confidence <= 0.5 || args->confidence >= 1)
+				argp_error(state, "%s is not a valid confidence - try 0.9-0.9999", arg);
+			return 0;
+		case EMBEDDED_RATE_KEY:
+			args->embeddedRate = atof(arg);
+			if (args->embeddedRate <= 0 || args->embeddedRate >= 1)
+				argp_error(state, "%s is not a valid hit rate - try 0.5-0.9", arg);
+			return 0;
+		case CLEAN_RATE_KEY:
+			args->cleanRate = atof(arg);
+			if (args->cleanRate <= 0 || args->cleanRate >= 1)
+				argp_error(state, "%s is not a valid hit rate - try 0.2-0.5", arg);
+			return 0;
+		case LAMBDA_KEY:
+			args->lambda = atoi(arg);
+			if (args->lambda < 8 || args->lambda > 127)
+				argp_error(state, "%s is not a valid lambda - try 8-127", arg);
+			return 0;
+		case FULL_SCAN_KEY:
+			args->fullScan = true;
+			return 0;
 		case ARGP_KEY_ARG: // A non-option key - the audio file or output file
 			switch (state->arg_num) {
 				case 0: args->audioFile = arg; break;
@@ -69,7 +111,7 @@ error_t miaoDetectParser (int key, char *arg, struct argp_state *state) {
 		case ARGP_KEY_END: // End of non-options - check to make sure we have the audio file and ks are valid
 			if (!args->audioFile)
 				argp_usage(state);
-			if (args->lowK == -1 || args->highK == -1)
+			if (args->lowK == (unsigned int) -1 || args->highK == (unsigned int) -1)
 				argp_usage(state);
 			if (args->lowK > args->highK)
 				argp_error(state, "incorrect order for k values");
@@ -77,6 +119,8 @@ error_t miaoDetectParser (int key, char *arg, struct argp_state *state) {
 				argp_error(state, "invalid lower k - try 1-79");
 			if (args->highK < 1 || args->highK > 79)
 				argp_error(state, "invalid upper k - try 1-79");
+			if (args->cleanRate >= args->embeddedRate)
+				argp_error(state, "embedded hit rate must exceed the clean hit rate");
 			return 0;
 		default:
 			return ARGP_ERR_UNKNOWN;
@@ -86,6 +130,11 @@ error_t miaoDetectParser (int key, char *arg, struct argp_state *state) {
 static struct argp_option miaoDetectArgp_opts[] = { // options
 	{LOW_K_OPTION, LOW_K_KEY, LOW_K_OPTION, 0, "Lowest k value to try"},
 	{HIGH_K_OPTION, HIGH_K_KEY, HIGH_K_OPTION, 0, "Highest k value to try"},
+	{CONFIDENCE_OPTION, CONFIDENCE_KEY, CONFIDENCE_OPTION, 0, "Confidence required to confirm or drop a hypothesis (default 0.99)"},
+	{EMBEDDED_RATE_OPTION, EMBEDDED_RATE_KEY, EMBEDDED_RATE_OPTION, 0, "Lowest window hit rate expected of Miao-encoded audio (default 0.6)"},
+	{CLEAN_RATE_OPTION, CLEAN_RATE_KEY, CLEAN_RATE_OPTION, 0, "Highest window hit rate expected without Miao encoding (default 0.4)"},
+	{LAMBDA_OPTION, LAMBDA_KEY, LAMBDA_OPTION, 0, "Lowest lambda the encoder may have used (default 60, as for the encoder)"},
+	{FULL_SCAN_OPTION, FULL_SCAN_KEY, 0, 0, "Scan the whole file even once a hypothesis is confirmed"},
 	{ 0 }
 };
 
@@ -96,57 +145,260 @@ static struct argp miaoDetectArgp_base = { // parsers
 	miaoDoc // brief description
 };
 
-// ----- Program -----
+// ----- Sequential test -----
+
+// Every window of 2k+1 samples starting at (offset + m*(2k+1)) is a trial.
+// A trial is a hit if the window sum is divisible by 2k+1, which Miao
+// embedding guarantees for every window it touches. Without embedding,
+// hits occur near the chance rate of 1/(2k+1), or about 1/3 where the
+// window is aligned with three windows of a smaller, embedded k - so the
+// test is between a clean and an embedded rate either side of that.
+#define UNDECIDED 0
+#define REJECTED 1
+#define CONFIRMED 2
+
+typedef struct hypothesisS {
+	unsigned int hits, windows;
+	double llr;
+	int decision;
+} hypothesis;
 
 typedef struct kqueueS {
 	int sum;
-	unsigned int hits, misses;
+	unsigned int n;
+	std::vector<hypothesis> offsets;
 } kqueue;
 
+// Wilson score interval for a hit rate at a two-sided normal quantile z
+static void wilson(unsigned int hits, unsigned int windows, double z, double *low, double *high) {
+	if (!windows) {
+		*low = 0;
+		*high = 1;
+		return;
+	}
+	double p = 1.0 * hits / windows;
+	double z2n = z * z / windows;
+	double centre = (p + z2n / 2) / (1 + z2n);
+	double spread = z * sqrt(p * (1 - p) / windows + z2n / (4 * windows)) / (1 + z2n);
+	*low = centre - spread;
+	*high = centre + spread;
+	if (*low < 0) *low = 0;
+	if (*high > 1) *high = 1;
+}
+
+// Two-sided standard normal quantile for a confidence level, found by bisection
+static double normalQuantile(double confidence) {
+	double low = 0, high = 10;
+	for (int i = 0; i < 100; i++) {
+		double mid = (low + high) / 2;
+		if (erfc(mid / sqrt(2.0)) > 1 - confidence)
+			low = mid;
+		else
+			high = mid;
+	}
+	return (low + high) / 2;
+}
+
+static const char* decisionName(int decision) {
+	switch (decision) {
+		case REJECTED: return "rejected";
+		case CONFIRMED: return "confirmed";
+		default: return "undecided";
+	}
+}
+
+// Miao's delta groups, as used by MiaoStegAlgorithm when deciding whether a
+// window can carry data; indexed by delta + MAX_DELTA
+#define MAX_DELTA 256
+static short groupLow[2*MAX_DELTA + 1], groupHigh[2*MAX_DELTA + 1];
+
+static void buildGroups() {
+	for (int delta = -MAX_DELTA; delta <= MAX_DELTA; delta++) {
+		int magnitude = std::abs(delta), low, high;
+		if (magnitude <= 1) {
+			low = -1;
+			high = 1;
+		} else {
+			// Groups are [2,3], [4,7], ..., [128,256]
+			for (low = 2; low * 2 <= magnitude && low < 128; low *= 2);
+			high = (low == 128) ? 256 : low * 2 - 1;
+			if (delta < 0) {
+				int tmp = low;
+				low = -high;
+				high = -tmp;
+			}
+		}
+		groupLow[delta + MAX_DELTA] = low;
+		groupHigh[delta + MAX_DELTA] = high;
+	}
+}
+
+// Whether Miao embedding would have touched the window at the given lambda,
+// or any larger one. The receiver makes the same decision on tampered audio,
+// so windows failing this carry no evidence either way and are not counted.
+static bool embeddable(const std::vector<short> &history, unsigned int last,
+	unsigned int n, int sum, int lambda) {
+	
+	int mu = (int)floor(((double)sum) / n);
+	int tU = mu, tL = mu;
+	unsigned int length = history.size();
+	unsigned int first = last + length - n + 1;
+	for (unsigned int i = 0; i < n; i++) {
+		if (i == n / 2) continue;
+		int delta = mu - history[(first + i) % length];
+		tU += groupHigh[delta + MAX_DELTA];
+		tL += groupLow[delta + MAX_DELTA];
+	}
+	return std::abs(tU) <= lambda && std::abs(tL) <= lambda;
+}
+
+// ----- Program -----
+
+#define READ_BLOCK 4096
+
 int main(int argc, char **argv) {
 	miaoDetectArgs args;
 	args.lowK = args.highK = -1;
+	args.confidence = 0.99;
+	args.embeddedRate = 0.6;
+	args.cleanRate = 0.4;
+	args.lambda = 60;
+	args.fullScan = false;
 	args.audioFile = NULL;
 	argp_parse (&miaoDetectArgp_base, argc, argv, 0, 0, &args);
+	buildGroups();
 	
 	// Open audio file
 	std::ifstream audio;
-	audio.open(args.audioFile, std::ios::in | std::ios::binary);
+	audio.open(args.audioFile, std::ios::in | std::ios::binary | std::ios::ate);
 	if (!audio.is_open()) {
 		std::cout << "Couldn't open file " << args.audioFile << std::endl;
 		return 1;
 	}
+	unsigned int fileSamples = audio.tellg();
+	audio.seekg(0, std::ios::beg);
 	
-	// Create queues for the various k values
+	// Wald's thresholds, with equal error rates either way
+	double errorRate = 1 - args.confidence;
+	double upper = log((1 - errorRate) / errorRate);
+	double lower = log(errorRate / (1 - errorRate));
+	double llrHit = log(args.embeddedRate / args.cleanRate);
+	double llrMiss = log((1 - args.embeddedRate) / (1 - args.cleanRate));
+	
+	// Create queues for the various k values, each with one hypothesis per offset
 	std::vector<kqueue> kqueues;
-	for (unsigned int k = args.lowK; k <= args.highK; k++)
-		kqueues.push_back({0,0,0});
+	unsigned int undecided = 0;
+	for (unsigned int k = args.lowK; k <= args.highK; k++) {
+		kqueue q;
+		q.sum = 0;
+		q.n = 2*k + 1;
+		q.offsets.assign(q.n, (hypothesis){0, 0, 0, UNDECIDED});
+		undecided += q.n;
+		kqueues.push_back(q);
+	}
+	
+	// The last 2*highK+1 samples, so every k can slide its window by one
+	unsigned int historyLength = 2*args.highK + 1;
+	std::vector<short> history(historyLength, 0);
 	
 	unsigned int samplesProcessed = 0;
-	g711Audio audioIn;
+	hypothesis *confirmed = NULL;
+	unsigned int confirmedK = 0, confirmedOffset = 0;
+	g711Audio audioIn[READ_BLOCK];
 	G711Sample sample;
 	
-	audio.read((char*)&audioIn, 1);
-	while (audio.gcount()) {
-		samplesProcessed++;
-		sample = G711Sample(ALAW, audioIn);
-		short signedSample = sample.uninvertedSignedSample();
-		for (unsigned int i = 0, k = args.lowK; k <= args.highK; i++, k++) {
-			kqueues.at(i).sum += signedSample;
-			if (samplesProcessed % (2*k + 1) == 0) {
-				if (kqueues.at(i).sum % (2*k + 1) == 0)
-					kqueues.at(i).hits++;
-				else
-					kqueues.at(i).misses++;
+	audio.read((char*)audioIn, READ_BLOCK);
+	unsigned int count = audio.gcount();
+	bool searching = true;
+	while (count && searching) {
+		for (unsigned int b = 0; b < count && searching; b++) {
+			sample = G711Sample(ALAW, audioIn[b]);
+			short signedSample = sample.uninvertedSignedSample();
+			unsigned int slot = samplesProcessed % historyLength;
+			short leaving = history.at(slot);
+			history.at(slot) = signedSample;
+			samplesProcessed++;
+			
+			for (unsigned int i = 0, k = args.lowK; k <= args.highK; i++, k++) {
+				kqueue &q = kqueues.at(i);
+				q.sum += signedSample;
+				if (samplesProcessed > q.n)
+					q.sum -= (q.n == historyLength) ? leaving :
+						history.at((slot + historyLength - q.n) % historyLength);
+				if (samplesProcessed < q.n)
+					continue;
+				
+				// The window just completed started at samplesProcessed - n
+				unsigned int offset = samplesProcessed % q.n;
+				hypothesis &h = q.offsets.at(offset);
+				if (h.decision == REJECTED && !args.fullScan)
+					continue;
+				if (!embeddable(history, slot, q.n, q.sum, args.lambda))
+					continue;
+				
+				h.windows++;
+				if (q.sum % (int)q.n == 0) {
+					h.hits++;
+					h.llr += llrHit;
+				} else {
+					h.llr += llrMiss;
+				}
 				
-				kqueues.at(i).sum = 0;
+				if (h.decision == UNDECIDED) {
+					if (h.llr <= lower) {
+						h.decision = REJECTED;
+						undecided--;
+					} else if (h.llr >= upper) {
+						h.decision = CONFIRMED;
+						undecided--;
+						if (!confirmed) {
+							confirmed = &h;
+							confirmedK = k;
+							confirmedOffset = offset;
+						}
+					}
+				}
 			}
+			
+			// Done once something is confirmed, or nothing is left to confirm
+			if (!args.fullScan && (confirmed || !undecided))
+				searching = false;
 		}
 		
-		audio.read((char*)&audioIn, 1);
+		audio.read((char*)audioIn, READ_BLOCK);
+		count = audio.gcount();
 	}
 	
-	for (unsigned int i = 0, k = args.lowK; k <= args.highK; i++, k++)
-		printf("k = %i : %i hits (%i%%)\n", k, kqueues.at(i).hits,
-			kqueues.at(i).hits * 100 / (kqueues.at(i).hits + kqueues.at(i).misses));
+	double z = normalQuantile(args.confidence);
+	printf("Read %u of %u samples (%.1f%%)\n", samplesProcessed, fileSamples,
+		fileSamples ? samplesProcessed * 100.0 / fileSamples : 100.0);
+	
+	// Report the strongest offset for each k
+	for (unsigned int i = 0, k = args.lowK; k <= args.highK; i++, k++) {
+		kqueue &q = kqueues.at(i);
+		unsigned int best = 0, rejected = 0;
+		for (unsigned int o = 0; o < q.n; o++) {
+			if (q.offsets.at(o).decision == REJECTED) rejected++;
+			if (q.offsets.at(o).llr > q.offsets.at(best).llr) best = o;
+		}
+		hypothesis &h = q.offsets.at(best);
+		double low, high;
+		wilson(h.hits, h.windows, z, &low, &high);
+		printf("k = %i : %i hits (%i%%) of %i windows at offset %i, %g%% CI [%.1f%%, %.1f%%], %s; %i/%i offsets rejected\n",
+			k, h.hits, h.windows ? h.hits * 100 / h.windows : 0, h.windows, best,
+			args.confidence * 100, low * 100, high * 100, decisionName(h.decision),
+			rejected, q.n);
+	}
+	
+	if (confirmed) {
+		double low, high;
+		wilson(confirmed->hits, confirmed->windows, z, &low, &high);
+		printf("Confirmed k = %i at offset %i after %i windows, %i%% hit rate, %g%% CI [%.1f%%, %.1f%%]\n",
+			confirmedK, confirmedOffset, confirmed->windows, confirmed->hits * 100 / confirmed->windows,
+			args.confidence * 100, low * 100, high * 100);
+	} else if (!undecided) {
+		printf("All hypotheses rejected\n");
+	} else {
+		printf("No hypothesis confirmed\n");
+	}
 }
@@ -0,0 +1,193 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef NEALPACKETEXTRACTOR_HPP
+#define NEALPACKETEXTRACTOR_HPP
+
+#include "NealStegAlgorithm.hpp"
+#include "../common/MappedFile.hpp"
+#include "../common/CarrierFile.hpp"
+#include "../common/CapacitySidecar.hpp"
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+#define NEAL_INDEX_MAGIC "NEALIDX2"
+
+// Layout of the start of a capacity index file. The header is followed by
+// (packets + 1) unsigned long longs: the number of hidden bits before each
+// packet, then the total.
+typedef struct nealIndexHeaderS {
+	char magic[8];
+	unsigned int bitrate;
+	unsigned int law;
+	unsigned long long carrierSize;
+	unsigned long long packets;
+	unsigned long long carrierHash; // FNV-1a of the carrier samples, as in a capacity sidecar
+} nealIndexHeader;
+
+// Neal resets the comparison codec at the start of every packet, so the data
+// hidden in a packet depends on nothing but that packet's samples. This
+// recovers hidden data from any packet of a mapped carrier without
+// processing the packets before it. The carrier may be raw or a WAV file,
+// in which case the header decides alaw or ulaw.
+class NealPacketExtractor {
+	private:
+		CarrierReader carrier;
+		bool law;
+		unsigned int g726bitrate;
+		NealStegAlgorithm neal;
+		bool nealUsed;
+		
+		// Hidden bits before each packet, either built here or mapped from
+		// an index file; bitOffsets[packets()] is the total
+		std::vector<unsigned long long> builtOffsets;
+		MappedFile *indexFile;
+		const unsigned long long *bitOffsets;
+		
+		void fillHeader(nealIndexHeader *header) {
+			memcpy(header->magic, NEAL_INDEX_MAGIC, sizeof(header->magic));
+			header->bitrate = g726bitrate;
+			header->law = law;
+			header->carrierSize = carrier.size();
+			header->packets = packets();
+			header->carrierHash = CapacitySidecar::hash(carrier.data(), carrier.size());
+		}
+		
+	public:
+		NealPacketExtractor(const char *fileName, bool law, unsigned int g726bitrate = 40000) :
+			carrier(fileName), law(law), g726bitrate(g726bitrate), neal(g726bitrate),
+			nealUsed(false), indexFile(NULL), bitOffsets(NULL) {
+				if (carrier.isWave() && WaveFile::isG711(carrier.wave()))
+					this->law = (carrier.wave().format == WAVE_FORMAT_MULAW);
+				carrier.adviseRandom();
+			}
+		
+		bool isOpen() { return carrier.isOpen(); }
+		
+		// Number of packets in the carrier, counting a partial last packet
+		length_t packets() {
+			return (carrier.size() + SAMPLES_PER_PACKET - 1) / SAMPLES_PER_PACKET;
+		}
+		
+		// Recover the hidden data of one packet into stegData and bitLength,
+		// which must have room for SAMPLES_PER_PACKET entries. Returns the
+		// number of samples in the packet (0 if there is no such packet).
+		length_t extractPacket(index_t packet, steg_t *stegData, length_t *bitLength) {
+			if (packet >= packets()) return 0;
+			
+			size_t start = (size_t) packet * SAMPLES_PER_PACKET;
+			length_t count = SAMPLES_PER_PACKET;
+			if (start + count > carrier.size()) count = carrier.size() - start;
+			
+			G711Sample samples[SAMPLES_PER_PACKET];
+			const g711Audio *audio = carrier.data() + start;
+			for (index_t i = 0; i < count; i++)
+				samples[i] = G711Sample(law, audio[i]);
+			
+			// Start from a freshly reset codec, exactly as at any packet
+			// boundary when the carrier is processed from the beginning
+			if (nealUsed)
+				neal.resetTampered();
+			neal.pushTamperedSamples(samples, count);
+			nealUsed = true;
+			
+			int state[SAMPLES_PER_PACKET];
+			return neal.popRecoveredData(stegData, bitLength, state, count);
+		}
+		
+		// Count the hidden bits in every packet, for bit offset lookups
+		void buildIndex() {
+			steg_t stegData[SAMPLES_PER_PACKET];
+			length_t bitLength[SAMPLES_PER_PACKET];
+			length_t total = packets();
+			
+			builtOffsets.assign(total + 1, 0);
+			for (index_t p = 0; p < total; p++) {
+				length_t count = extractPacket(p, stegData, bitLength);
+				unsigned long long bits = 0;
+				for (index_t i = 0; i < count; i++)
+					bits += bitLength[i];
+				builtOffsets[p + 1] = builtOffsets[p] + bits;
+			}
+			bitOffsets = &builtOffsets[0];
+		}
+		
+		// Write the index built by buildIndex() to a file
+		bool saveIndex(const char *fileName) {
+			if (!bitOffsets) return false;
+			
+			nealIndexHeader header;
+			fillHeader(&header);
+			
+			std::ofstream out(fileName, std::ios::out | std::ios::binary | std::ios::trunc);
+			if (!out.is_open()) return false;
+			out.write((const char*) &header, sizeof(header));
+			out.write((const char*) bitOffsets, (packets() + 1) * sizeof(unsigned long long));
+			return out.good();
+		}
+		
+		// Map a previously saved index file. Fails if it doesn't exist or
+		// was built for a different carrier (even one of the same length),
+		// law or bitrate.
+		bool loadIndex(const char *fileName) {
+			MappedFile *mapped = new MappedFile(fileName);
+			
+			nealIndexHeader expected;
+			size_t expectedSize = sizeof(expected) + (packets() + 1) * sizeof(unsigned long long);
+			if ((!mapped->isOpen()) || (mapped->size() != expectedSize)) {
+				delete mapped;
+				return false;
+			}
+			
+			// Only hash the carrier once the file looks plausible
+			fillHeader(&expected);
+			if (memcmp(mapped->data(), &expected, sizeof(expected))) {
+				delete mapped;
+				return false;
+			}
+			
+			if (indexFile) delete indexFile;
+			indexFile = mapped;
+			indexFile->adviseRandom();
+			bitOffsets = (const unsigned long long*) (indexFile->data() + sizeof(expected));
+			return true;
+		}
+		
+		bool hasIndex() { return bitOffsets != NULL; }
+		
+		// The following require an index
+		
+		unsigned long long totalBits() { return bitOffsets[packets()]; }
+		
+		// Bit offset of the first bit hidden in a packet
+		unsigned long long firstBitOfPacket(index_t packet) { return bitOffsets[packet]; }
+		
+		// The packet holding a given bit offset, found by binary search;
+		// returns packets() if the offset is past the end
+		index_t packetForBit(unsigned long long bit) {
+			if (bit >= totalBits()) return packets();
+			return (std::upper_bound(bitOffsets, bitOffsets + packets() + 1, bit) - bitOffsets) - 1;
+		}
+		
+		~NealPacketExtractor() {
+			if (indexFile) delete indexFile;
+		}
+};
+
+#endif
@@ -20,10 +20,66 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "../ito/ItoStegAlgorithm.hpp"
 #include "NealQueue.hpp"
+#include "../common/WorkerPool.hpp"
 #include <cstdlib>
 #include <cstring>
+#include <vector>
 
-class NealStegAlgorithm : public ItoStegAlgorithm {
+class NealStegAlgorithm final : public ItoStegAlgorithm {
+	private:
+		unsigned int workerThreads;
+		WorkerPool *pool; // Started on first use, and kept
+		
+		// Only copied by construction, which leaves the pool behind
+		NealStegAlgorithm& operator=(const NealStegAlgorithm&);
+		
+		// Processes whole packets, starting on a packet boundary, using a
+		// fresh codec per packet. Every packet is independent of the others
+		// so they're split among the worker threads.
+		void processPackets(const G711Sample *samples, length_t packets, ItoG711Sample **out) {
+			if (!pool) pool = new WorkerPool(workerThreads);
+			unsigned int threads = pool->size();
+			if (threads > packets) threads = packets;
+			
+			pool->run(threads, [=](unsigned int t) {
+				g726_state_t codec;
+				for (index_t p = t; p < packets; p += threads) {
+					g726_init(&codec, g726Bitrate, G726_ENCODING_LINEAR, G726_PACKING_NONE);
+					for (index_t i = p * SAMPLES_PER_PACKET; i < (p + 1) * SAMPLES_PER_PACKET; i++)
+						out[i] = processSample(samples[i], &codec);
+				}
+			});
+		}
+		
+		// Same as posting each sample to the queue in turn, but any whole
+		// packets are processed in parallel when there are threads to do so
+		void postAllToQueue(const G711Sample *samples, length_t length, ItoQueue **toQueue) {
+			// Finish off any packet already in progress
+			while ((length) && ((*toQueue == NULL) ||
+				(((NealQueue*) *toQueue)->sampleIndexInPacket != 0))) {
+					postToQueue(*samples++, toQueue);
+					length--;
+				}
+			
+			length_t packets = length / SAMPLES_PER_PACKET;
+			if ((workerThreads > 1) && (packets > 1) && (!usingExpected) && (!usingKnownCapacity(toQueue))) {
+				length_t count = packets * SAMPLES_PER_PACKET;
+				std::vector<ItoG711Sample*> processed(count);
+				processPackets(samples, packets, &processed[0]);
+				
+				// The queue codec is already freshly reset at a packet
+				// boundary, and will be again after the last whole packet
+				(*toQueue)->samples.insert((*toQueue)->samples.end(),
+					processed.begin(), processed.end());
+				
+				samples += count;
+				length -= count;
+			}
+			
+			for (index_t i = 0; i < length; i++)
+				postToQueue(samples[i], toQueue);
+		}
+		
 	protected:
 		virtual void postToQueue(G711Sample sample, ItoQueue **toQueue) {			
 			// Run the overridden method as normal (create the queue if applicable)
@@ -53,9 +109,33 @@ class NealStegAlgorithm : public ItoStegAlgorithm {
 		
 	public:
 		NealStegAlgorithm(unsigned int g726bitrate = 40000) :
-			ItoStegAlgorithm(g726bitrate) {}
+			ItoStegAlgorithm(g726bitrate), workerThreads(1), pool(NULL) {}
 		
-		virtual ~NealStegAlgorithm() {}
+		// Copies start their own threads if they need them
+		NealStegAlgorithm(const NealStegAlgorithm &other) :
+			ItoStegAlgorithm(other), workerThreads(other.workerThreads), pool(NULL) {}
+		
+		virtual void pushUntamperedSamples(const G711Sample *samples, length_t length) {
+			postAllToQueue(samples, length, &untamperedSending);
+		}
+		
+		virtual void pushTamperedSamples(const G711Sample *samples, length_t length) {
+			postAllToQueue(samples, length, &tamperedReceiving);
+		}
+		
+		virtual std::string capacityKey() {
+			return "neal/" + std::to_string(g726Bitrate);
+		}
+		
+		virtual void setWorkerThreads(unsigned int threads) {
+			workerThreads = threads ? threads : 1;
+			if (pool) delete pool;
+			pool = NULL;
+		}
+		
+		virtual ~NealStegAlgorithm() {
+			if (pool) delete pool;
+		}
 };
 
 #endif
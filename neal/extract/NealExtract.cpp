@@ -0,0 +1,313 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <argp.h>
+#include <vector>
+#include <cstdlib>
+#include <cstdio>
+#include <iostream>
+#include <fstream>
+#include "../NealPacketExtractor.hpp"
+
+// ----- Usage, Arguments Handling -----
+
+#define ALAW_OPTION "alaw"
+#define ALAW_KEY 'a'
+#define ULAW_OPTION "ulaw"
+#define ULAW_KEY 'u'
+#define BITRATE_OPTION "g726bitrate"
+#define BITRATE_KEY 'b'
+#define INDEX_OPTION "index"
+#define INDEX_KEY 'i'
+#define PACKETS_OPTION "packets"
+#define PACKETS_KEY 'p'
+#define BITS_OPTION "bits"
+#define BITS_KEY 'r'
+#define DETAILED_OPTION "detailed"
+#define DETAILED_KEY 'd'
+
+static const char *nealExtractArgsDoc = "G711AUDIO OUTPUT";
+static const char *nealExtractDoc = "Random-access extraction of Neal-encoded audio\v"
+	"Packets are decoded independently, so only the packets asked for are read "
+	"from G711AUDIO. Ranges are inclusive and may be given more than once; their "
+	"hidden bits are written to OUTPUT in the order given, eight to a byte, with "
+	"any final partial byte padded with zero bits. Bit ranges need a capacity "
+	"index, which is loaded from --index if it matches G711AUDIO, or otherwise "
+	"built (and saved to --index, if given).";
+
+typedef struct rangeS {
+	unsigned long long first, last;
+} range;
+
+typedef struct nealExtractArgsS {
+	bool isAlaw, isUlaw;
+	unsigned int bitrate;
+	char* indexFile;
+	std::vector<range> packetRanges;
+	std::vector<range> bitRanges;
+	char* detailedFile;
+	char* audioFile;
+	char* outputFile;
+} nealExtractArgs;
+
+// Parse FIRST or FIRST-LAST
+static bool parseRange(char *arg, range *out) {
+	char *end;
+	out->first = strtoull(arg, &end, 10);
+	if (end == arg) return false;
+	if (*end == '\0') {
+		out->last = out->first;
+		return true;
+	}
+	if (*end != '-') return false;
+	char *lastStr = end + 1;
+	out->last = strtoull(lastStr, &end, 10);
+	return (end != lastStr) && (*end == '\0') && (out->first <= out->last);
+}
+
+error_t nealExtractParser (int key, char *arg, struct argp_state *state) {
+	nealExtractArgs *args = (nealExtractArgs*) state->input;
+	range r;
+	switch (key) {
+		case ALAW_KEY:
+			args->isAlaw = true;
+			return 0;
+		case ULAW_KEY:
+			args->isUlaw = true;
+			return 0;
+		case BITRATE_KEY:
+			args->bitrate = atoi(arg);
+			switch (args->bitrate) {
+				case 40000:
+				case 32000:
+				case 24000:
+				case 16000:
+					break;
+				default:
+					argp_error(state, "%s is not a valid bitrate - try {16,24,32,40}000", arg);
+			}
+			return 0;
+		case INDEX_KEY:
+			args->indexFile = arg;
+			return 0;
+		case PACKETS_KEY:
+			if (!parseRange(arg, &r))
+				argp_error(state, "%s is not a valid packet range - try FIRST or FIRST-LAST", arg);
+			args->packetRanges.push_back(r);
+			return 0;
+		case BITS_KEY:
+			if (!parseRange(arg, &r))
+				argp_error(state, "%s is not a valid bit range - try FIRST or FIRST-LAST", arg);
+			args->bitRanges.push_back(r);
+			return 0;
+		case DETAILED_KEY:
+			args->detailedFile = arg;
+			return 0;
+		case ARGP_KEY_ARG: // A non-option key - the audio file or output file
+			switch (state->arg_num) {
+				case 0: args->audioFile = arg; break;
+				case 1: args->outputFile = arg; break;
+				default: argp_usage(state);
+			}
+			return 0;
+		case ARGP_KEY_END: // End of non-options - check to make sure we have both files
+			if ((!args->audioFile) || (!args->outputFile))
+				argp_usage(state);
+			if (args->isAlaw && args->isUlaw)
+				argp_error(state, "alaw and ulaw are mutually exclusive options");
+			if (args->packetRanges.empty() && args->bitRanges.empty() && (!args->indexFile))
+				argp_error(state, "nothing to do - give packet or bit ranges, or an index to build");
+			return 0;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+}
+
+static struct argp_option nealExtractArgp_opts[] = { // options
+	{ALAW_OPTION, ALAW_KEY, 0, 0, "Assume G711AUDIO is alaw stream (default)"},
+	{ULAW_OPTION, ULAW_KEY, 0, 0, "Assume G711AUDIO is ulaw stream"},
+	{BITRATE_OPTION, BITRATE_KEY, BITRATE_OPTION, 0, "Bitrate for the comparison codec (default 40000)"},
+	{INDEX_OPTION, INDEX_KEY, "FILE", 0, "Capacity index to load, or to create if missing or stale"},
+	{PACKETS_OPTION, PACKETS_KEY, "FIRST[-LAST]", 0, "Extract the bits hidden in these packets"},
+	{BITS_OPTION, BITS_KEY, "FIRST[-LAST]", 0, "Extract these hidden bits, by offset into the whole hidden stream"},
+	{DETAILED_OPTION, DETAILED_KEY, "FILE", 0, "Write each extracted sample's packet, data and bit length to a file"},
+	{ 0 }
+};
+
+static struct argp nealExtractArgp_base = { // parsers
+	nealExtractArgp_opts, // options
+	nealExtractParser, // parsing function
+	nealExtractArgsDoc, // two non-option arguments
+	nealExtractDoc // brief description
+};
+
+// ----- Output -----
+
+// Packs bits into bytes, least significant bit first, as main does
+class BitWriter {
+	private:
+		std::ofstream *out;
+		unsigned char thisByte, byteMask;
+	
+	public:
+		unsigned long long written;
+		
+		BitWriter(std::ofstream *out) : out(out), thisByte(0), byteMask(1), written(0) {}
+		
+		void put(steg_t data, length_t length) {
+			for (index_t i = 0; i < length; i++, data >>= 1) {
+				if (data & 1) thisByte |= byteMask;
+				byteMask <<= 1;
+				written++;
+				if (!byteMask) {
+					out->put((char) thisByte);
+					thisByte = 0;
+					byteMask = 1;
+				}
+			}
+		}
+		
+		void flush() {
+			if (byteMask != 1) out->put((char) thisByte);
+			thisByte = 0;
+			byteMask = 1;
+		}
+};
+
+// Extracts packets first to last (inclusive), keeping only the hidden bits
+// from offset skip (relative to the first packet) onwards, and at most
+// limit of them
+static void extractPackets(NealPacketExtractor *extractor, index_t first, index_t last,
+	unsigned long long skip, unsigned long long limit, BitWriter *writer, std::ofstream *detailed) {
+	steg_t stegData[SAMPLES_PER_PACKET];
+	length_t bitLength[SAMPLES_PER_PACKET];
+	
+	for (index_t p = first; (p <= last) && limit; p++) {
+		length_t count = extractor->extractPacket(p, stegData, bitLength);
+		for (index_t i = 0; (i < count) && limit; i++) {
+			steg_t data = stegData[i];
+			length_t length = bitLength[i];
+			
+			if (skip >= length) {
+				skip -= length;
+				continue;
+			}
+			data >>= skip;
+			length -= skip;
+			skip = 0;
+			if (length > limit) length = limit;
+			limit -= length;
+			
+			if (detailed) {
+				*detailed << p << "\t";
+				*detailed << i << "\t";
+				*detailed << (data & ((1 << length) - 1)) << "\t";
+				*detailed << length << std::endl;
+			}
+			writer->put(data, length);
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	nealExtractArgs args;
+	args.isAlaw = args.isUlaw = false;
+	args.bitrate = 40000;
+	args.indexFile = NULL;
+	args.detailedFile = NULL;
+	args.audioFile = args.outputFile = NULL;
+	argp_parse (&nealExtractArgp_base, argc, argv, 0, 0, &args);
+	
+	bool law = args.isUlaw ? ULAW : ALAW;
+	
+	NealPacketExtractor extractor(args.audioFile, law, args.bitrate);
+	if (!extractor.isOpen()) {
+		std::cout << "[NealExtract] Couldn't open file " << args.audioFile << std::endl;
+		return 1;
+	}
+	std::cout << "[NealExtract] " << extractor.packets() << " packets in " << args.audioFile << std::endl;
+	
+	// Only bit ranges need the index, but if one was named make sure it exists
+	if ((!args.bitRanges.empty()) || (args.indexFile)) {
+		if ((args.indexFile) && (extractor.loadIndex(args.indexFile))) {
+			std::cout << "[NealExtract] Loaded index " << args.indexFile << std::endl;
+		} else {
+			std::cout << "[NealExtract] Building index" << std::endl;
+			extractor.buildIndex();
+			if (args.indexFile) {
+				if (extractor.saveIndex(args.indexFile))
+					std::cout << "[NealExtract] Saved index " << args.indexFile << std::endl;
+				else
+					std::cout << "[NealExtract] Couldn't save index " << args.indexFile << std::endl;
+			}
+		}
+		std::cout << "[NealExtract] " << extractor.totalBits() << " hidden bits in total" << std::endl;
+	}
+	
+	std::ofstream output;
+	output.open(args.outputFile, std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!output.is_open()) {
+		std::cout << "[NealExtract] Couldn't open file " << args.outputFile << std::endl;
+		return 1;
+	}
+	
+	std::ofstream detailedOut;
+	if (args.detailedFile) {
+		detailedOut.open(args.detailedFile, std::ios::out | std::ios::trunc);
+		if (!detailedOut.is_open()) {
+			std::cout << "[NealExtract] Couldn't open file " << args.detailedFile << std::endl;
+			return 1;
+		}
+		detailedOut << "Packet\tSample\tData\tBits" << std::endl;
+	}
+	std::ofstream *detailed = args.detailedFile ? &detailedOut : NULL;
+	
+	BitWriter writer(&output);
+	unsigned long long everything = ~0ULL;
+	
+	for (index_t r = 0; r < args.packetRanges.size(); r++) {
+		range pr = args.packetRanges[r];
+		if (pr.first >= extractor.packets()) {
+			std::cout << "[NealExtract] Packet " << pr.first << " is past the end, skipped" << std::endl;
+			continue;
+		}
+		if (pr.last >= extractor.packets()) pr.last = extractor.packets() - 1;
+		extractPackets(&extractor, pr.first, pr.last, 0, everything, &writer, detailed);
+	}
+	
+	for (index_t r = 0; r < args.bitRanges.size(); r++) {
+		range br = args.bitRanges[r];
+		if (br.first >= extractor.totalBits()) {
+			std::cout << "[NealExtract] Bit " << br.first << " is past the end, skipped" << std::endl;
+			continue;
+		}
+		if (br.last >= extractor.totalBits()) br.last = extractor.totalBits() - 1;
+		
+		index_t first = extractor.packetForBit(br.first);
+		index_t last = extractor.packetForBit(br.last);
+		extractPackets(&extractor, first, last, br.first - extractor.firstBitOfPacket(first),
+			br.last - br.first + 1, &writer, detailed);
+	}
+	
+	writer.flush();
+	std::cout << "[NealExtract] Extracted " << writer.written << " bits to " << args.outputFile << std::endl;
+	
+	output.close();
+	if (args.detailedFile) detailedOut.close();
+	
+	return 0;
+}
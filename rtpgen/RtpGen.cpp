@@ -0,0 +1,229 @@
+/*
+(C) 2011 Harrison Neal, Hala ElAarag.
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <argp.h>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "../common/CarrierFile.hpp"
+#include "../common/RtpProxy.hpp"
+
+// ----- Usage, Arguments Handling -----
+
+#define ALAW_OPTION "alaw"
+#define ALAW_KEY 'a'
+#define ULAW_OPTION "ulaw"
+#define ULAW_KEY 'u'
+#define STREAMS_OPTION "streams"
+#define STREAMS_KEY 's'
+#define INTERVAL_OPTION "interval"
+#define INTERVAL_KEY 'i'
+
+#define RTP_GEN_FIRST_SSRC 0x10000000
+
+static const char *rtpGenArgsDoc = "G711AUDIO DESTINATION";
+static const char *rtpGenDoc = "Plays G711 audio as RTP streams over UDP, for trying out live embedding\v"
+	"Each stream plays G711AUDIO from the start, one packet of 160 samples per "
+	"interval, with its own SSRC (counting up from 10000000 hex). DESTINATION is "
+	"HOST:PORT or HOST:FIRST-LAST; streams are spread over the ports in turn. "
+	"A WAV file decides alaw or ulaw itself.";
+
+typedef struct rtpGenArgsS {
+	bool isAlaw, isUlaw;
+	unsigned int streams;
+	double interval;
+	char* audioFile;
+	char* destination;
+} rtpGenArgs;
+
+error_t rtpGenParser (int key, char *arg, struct argp_state *state) {
+	rtpGenArgs *args = (rtpGenArgs*) state->input;
+	switch (key) {
+		case ALAW_KEY:
+			args->isAlaw = true;
+			return 0;
+		case ULAW_KEY:
+			args->isUlaw = true;
+			return 0;
+		case STREAMS_KEY:
+			if (atoi(arg) < 1)
+				argp_error(state, "%s is not a valid stream count", arg);
+			args->streams = atoi(arg);
+			return 0;
+		case INTERVAL_KEY:
+			args->interval = atof(arg);
+			if (args->interval < 0)
+				argp_error(state, "%s is not a valid interval", arg);
+			return 0;
+		case ARGP_KEY_ARG: // A non-option key - the audio file or destination
+			switch (state->arg_num) {
+				case 0: args->audioFile = arg; break;
+				case 1: args->destination = arg; break;
+				default: argp_usage(state);
+			}
+			return 0;
+		case ARGP_KEY_END:
+			if ((!args->audioFile) || (!args->destination))
+				argp_usage(state);
+			if (args->isAlaw && args->isUlaw)
+				argp_error(state, "alaw and ulaw are mutually exclusive options");
+			return 0;
+		default:
+			return ARGP_ERR_UNKNOWN;
+	}
+}
+
+static struct argp_option rtpGenArgp_opts[] = { // options
+	{ALAW_OPTION, ALAW_KEY, 0, 0, "Assume G711AUDIO is alaw stream (default)"},
+	{ULAW_OPTION, ULAW_KEY, 0, 0, "Assume G711AUDIO is ulaw stream"},
+	{STREAMS_OPTION, STREAMS_KEY, "COUNT", 0, "Play COUNT streams at once (default 1)"},
+	{INTERVAL_OPTION, INTERVAL_KEY, "MS", 0, "Milliseconds between packets of a stream (default 20); 0 sends as fast as possible"},
+	{ 0 }
+};
+
+static struct argp rtpGenArgp_base = { // parsers
+	rtpGenArgp_opts, // options
+	rtpGenParser, // parsing function
+	rtpGenArgsDoc, // two non-option arguments
+	rtpGenDoc // brief description
+};
+
+// ----- Main -----
+
+int main(int argc, char **argv) {
+	rtpGenArgs args;
+	args.isAlaw = false;
+	args.isUlaw = false;
+	args.streams = 1;
+	args.interval = 20;
+	args.audioFile = NULL;
+	args.destination = NULL;
+	
+	argp_parse(&rtpGenArgp_base, argc, argv, 0, 0, &args);
+	
+	struct sockaddr_in destination;
+	unsigned int ports;
+	if (!RtpProxy::parseAddress(args.destination, &destination, &ports)) {
+		std::cout << "[RtpGen] Couldn't understand address " << args.destination << std::endl;
+		return 1;
+	}
+	
+	CarrierReader audio(args.audioFile);
+	if (!audio.isOpen()) {
+		std::cout << "[RtpGen] Couldn't open file " << args.audioFile << std::endl;
+		return 1;
+	}
+	bool isUlaw = args.isUlaw;
+	if (audio.isWave()) {
+		if (!WaveFile::isG711(audio.wave())) {
+			std::cout << "[RtpGen] File " << args.audioFile << " is a WAV file, but not mono alaw or ulaw" << std::endl;
+			return 1;
+		}
+		isUlaw = (audio.wave().format == WAVE_FORMAT_MULAW);
+	}
+	
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		std::cout << "[RtpGen] Couldn't open a socket: " << strerror(errno) << std::endl;
+		return 1;
+	}
+	
+	// Every stream sends the same payload at the same time, so only the
+	// headers differ
+	std::vector<struct sockaddr_in> to(args.streams, destination);
+	std::vector<unsigned char> packets(args.streams * (RTP_HEADER_LENGTH + SAMPLES_PER_PACKET));
+	for (index_t s = 0; s < args.streams; s++) {
+		to[s].sin_port = htons(ntohs(destination.sin_port) + (s % ports));
+		
+		unsigned char *header = &packets[s * (RTP_HEADER_LENGTH + SAMPLES_PER_PACKET)];
+		unsigned int ssrc = RTP_GEN_FIRST_SSRC + s;
+		header[0] = 0x80; // Version 2
+		header[1] = isUlaw ? RTP_PAYLOAD_PCMU : RTP_PAYLOAD_PCMA;
+		header[8] = ssrc >> 24;
+		header[9] = ssrc >> 16;
+		header[10] = ssrc >> 8;
+		header[11] = ssrc;
+	}
+	
+	std::cout << "[RtpGen] Sending " << args.streams << " " << (isUlaw ? "u" : "a") << "law streams of "
+		<< args.audioFile << " to " << args.destination << std::endl;
+	
+	struct mmsghdr messages[PROXY_BATCH];
+	struct iovec vectors[PROXY_BATCH];
+	struct timespec next;
+	clock_gettime(CLOCK_MONOTONIC, &next);
+	unsigned long long sent = 0;
+	
+	for (unsigned long long offset = 0, tick = 0; offset < audio.size(); offset += SAMPLES_PER_PACKET, tick++) {
+		length_t payloadLength = audio.size() - offset;
+		if (payloadLength > SAMPLES_PER_PACKET) payloadLength = SAMPLES_PER_PACKET;
+		unsigned int timestamp = offset;
+		
+		for (index_t s = 0; s < args.streams; s++) {
+			unsigned char *header = &packets[s * (RTP_HEADER_LENGTH + SAMPLES_PER_PACKET)];
+			header[2] = tick >> 8;
+			header[3] = tick;
+			header[4] = timestamp >> 24;
+			header[5] = timestamp >> 16;
+			header[6] = timestamp >> 8;
+			header[7] = timestamp;
+			memcpy(header + RTP_HEADER_LENGTH, audio.data() + offset, payloadLength);
+		}
+		
+		for (index_t first = 0; first < args.streams; ) {
+			length_t count = args.streams - first;
+			if (count > PROXY_BATCH) count = PROXY_BATCH;
+			
+			memset(messages, 0, sizeof(messages[0]) * count);
+			for (index_t i = 0; i < count; i++) {
+				vectors[i].iov_base = &packets[(first + i) * (RTP_HEADER_LENGTH + SAMPLES_PER_PACKET)];
+				vectors[i].iov_len = RTP_HEADER_LENGTH + payloadLength;
+				messages[i].msg_hdr.msg_iov = &vectors[i];
+				messages[i].msg_hdr.msg_iovlen = 1;
+				messages[i].msg_hdr.msg_name = &to[first + i];
+				messages[i].msg_hdr.msg_namelen = sizeof(to[first + i]);
+			}
+			
+			int done = sendmmsg(fd, messages, count, 0);
+			if (done <= 0) {
+				if ((done < 0) && (errno == EINTR)) continue;
+				std::cout << "[RtpGen] Couldn't send: " << strerror(errno) << std::endl;
+				close(fd);
+				return 1;
+			}
+			first += done;
+			sent += done;
+		}
+		
+		// Keep to the schedule, rather than sleeping a fixed time
+		if (args.interval > 0) {
+			long long nanoseconds = next.tv_nsec + (long long) (args.interval * 1000000);
+			next.tv_sec += nanoseconds / 1000000000;
+			next.tv_nsec = nanoseconds % 1000000000;
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+		}
+	}
+	
+	close(fd);
+	std::cout << "[RtpGen] Sent " << sent << " packets" << std::endl;
+	return 0;
+}
@@ -1,7 +1,20 @@
 #!/bin/bash
-# This assumes you have many .al files in an audio subdirectory.
+# This assumes you have many .al (or G711 .wav) files in an audio subdirectory.
 # The files will be processed in parallel.
-for i in audio/*.al
+# Each configuration already run (see runOne.sh) is taken from the cache.
+export CACHE_DIR=`echo "${CACHE_DIR:-.cache}"`
+mkdir -p "${CACHE_DIR}"
+rm -f "${CACHE_DIR}/report.log"
+
+for i in audio/*.al audio/*.wav
 do
+	[ -f "$i" ] || continue
 	./runOne.sh "$i" &
 done
+wait
+
+# Cache hit/miss report
+HITS=`grep -c "^hit " "${CACHE_DIR}/report.log"`
+MISSES=`grep -c "^miss " "${CACHE_DIR}/report.log"`
+echo "Cache: ${HITS} hits, ${MISSES} misses"
+grep "^miss " "${CACHE_DIR}/report.log" | sed 's/^miss /  computed: /'
@@ -0,0 +1,42 @@
+#!/bin/bash
+# Times embedding ${1} (a .al file) with each algorithm, for comparing
+# builds: run it before and after a change. Prints the best wall time of
+# ${REPEATS} runs (default 3) and how many times faster than real time that
+# is. Embeds the worst-case payload, or the file named by ${PAYLOAD}.
+# Binaries are taken from ${BIN_DIR} (default .).
+
+FILE="${1}"
+REPEATS="${REPEATS:-3}"
+BIN_DIR="${BIN_DIR:-.}"
+SECONDS_OF_AUDIO=`stat -c %s "${FILE}" | awk '{ print $1 / 8000 }'`
+OUT=`mktemp`
+if [ -n "${PAYLOAD}" ]
+then
+	PAYLOADARGS=(-f "${PAYLOAD}")
+else
+	PAYLOADARGS=()
+fi
+
+# bench BINARY [ALGORITHM PARAMETERS...]
+bench() {
+	local BINARY="${BIN_DIR}/${1}"
+	shift
+	local BEST=""
+	for ((r=0;r<REPEATS;r++))
+	do
+		local START=`date +%s.%N`
+		"${BINARY}" "$@" "${PAYLOADARGS[@]}" "${FILE}" "${OUT}" > /dev/null 2>&1
+		local END=`date +%s.%N`
+		BEST=`echo "${START} ${END} ${BEST}" | awk '{ t = $2 - $1; if ($3 != "" && $3 < t) t = $3; print t }'`
+	done
+	echo "${BEST} ${SECONDS_OF_AUDIO}" | awk -v name="${BINARY##*/} $*" \
+		'{ printf "%-24s %8.3f s %10.1fx real time\n", name, $1, $2 / $1 }'
+}
+
+bench main-lsb
+bench main-aoki -j 1
+bench main-ito -b 32000
+bench main-miao -k 10 -l 64
+bench main-neal -b 32000
+
+rm -f "${OUT}"
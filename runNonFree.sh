@@ -2,6 +2,8 @@
 # Use a non-free application to gain more statistics
 # http://www.itu.int/rec/T-REC-P.862-200102-I/en
 # May require a license
+# The carrier is converted to 16-bit PCM once; runOne.sh has the embed run
+# write ${PREFIX}${WORST} as 16-bit PCM already
 
 if [ ! -f "${FILE}.wav" ]
 then
@@ -10,12 +12,10 @@ then
 	rm -f "${FILE}.lock"
 fi
 
-sox "${PREFIX}${WORST}"{,.wav} 2>&1 > /dev/null
-
 while [ -f "${FILE}.lock" ]
 do
 	sleep 5
 done
 
-../pesq/pesqmain +8000 "${FILE}.wav" "${PREFIX}${WORST}.wav" 2>&1 > "${PREFIX}${FILENOSLASH}.pesq.txt"
+"${PESQBINARY:-../pesq/pesqmain}" +8000 "${FILE}.wav" "${PREFIX}${WORST}" 2>&1 > "${PREFIX}${FILENOSLASH}.pesq.txt"
 
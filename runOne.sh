@@ -1,31 +1,111 @@
 #!/bin/bash
-# You may choose to comment out the various references to runNonFree.sh.
+# The summary (.avg.txt) includes global and segmental SNR, log-spectral distance and
+# packet noise-signal ratio percentiles. Set PESQ=1 to also run runNonFree.sh
+# for a PESQ score, which needs sox (to convert the carrier) and the
+# non-free PESQ binary.
+# Results are cached in ${CACHE_DIR} (default .cache), keyed by the carrier's
+# contents, the binary, the algorithm parameters and the payload (worst-case,
+# or the file named by ${PAYLOAD}), and with PESQ by runNonFree.sh and the
+# PESQ binary (${PESQBINARY}); configurations already run are copied
+# from there instead of being run again. Delete the directory to start over.
 
 export FILE=`echo "${1}"`
 export FILENOSLASH=`echo "${FILE}" | cut -f 2 -d '/'`
-export WORST=`echo "${FILENOSLASH}.worst.al"`
+# WAV carriers give WAV outputs. For PESQ, the output is written as the
+# 16-bit PCM WAV it needs (-L), so it doesn't have to be converted
+if [ -n "${PESQ}" ]
+then
+	export WORST=`echo "${FILENOSLASH}.worst.pcm.wav"`
+	LINEARARGS=(-L)
+else
+	case "${FILE}" in
+		*.wav) export WORST=`echo "${FILENOSLASH}.worst.wav"` ;;
+		*) export WORST=`echo "${FILENOSLASH}.worst.al"` ;;
+	esac
+	LINEARARGS=()
+fi
+export CACHE_DIR=`echo "${CACHE_DIR:-.cache}"`
+
+mkdir -p "${CACHE_DIR}"
+FILEHASH=`sha256sum < "${FILE}" | cut -f 1 -d ' '`
+if [ -n "${PAYLOAD}" ]
+then
+	PAYLOADSOURCE=`sha256sum < "${PAYLOAD}" | cut -f 1 -d ' '`
+	PAYLOADARGS=(-f "${PAYLOAD}")
+else
+	PAYLOADSOURCE="worst"
+	PAYLOADARGS=()
+fi
+if [ -n "${PESQ}" ]
+then
+	export PESQBINARY=`echo "${PESQBINARY:-../pesq/pesqmain}"`
+	PESQSOURCE=`( sha256sum < runNonFree.sh; echo "${PESQBINARY}"; sha256sum < "${PESQBINARY}" ) | sha256sum | cut -f 1 -d ' '`
+else
+	PESQSOURCE=""
+fi
+HITS=0
+MISSES=0
+
+# runCached BINARY [ALGORITHM PARAMETERS...]
+# Embeds ${FILE} into ${PREFIX}${WORST} with the given binary and parameters,
+# then runs runNonFree.sh if asked to - or copies the results of doing so from the cache.
+runCached() {
+	local BINARY="${1}"
+	shift
+	local KEY=`( echo "${FILEHASH}"; sha256sum < "${BINARY}"; echo "${BINARY}" "$@"; echo "${PAYLOADSOURCE}"; echo "${PESQSOURCE}" ) | sha256sum | cut -f 1 -d ' '`
+	local ENTRY="${CACHE_DIR}/${KEY}"
+	local RESULTS=("${PREFIX}${FILENOSLASH}.avg.txt" "${PREFIX}${FILENOSLASH}.csv" "${PREFIX}${FILENOSLASH}.out.txt" "${PREFIX}${WORST}" "${PREFIX}${FILENOSLASH}.pesq.txt")
+
+	if [ -f "${ENTRY}/complete" ]
+	then
+		for f in "${RESULTS[@]}"
+		do
+			[ -f "${ENTRY}/${f##*/}" ] && cp "${ENTRY}/${f##*/}" "${f}"
+		done
+		HITS=$((HITS + 1))
+		echo "hit ${FILE} ${BINARY} $*" >> "${CACHE_DIR}/report.log"
+		return
+	fi
+
+	rm -f "${RESULTS[@]}"
+	"${BINARY}" "$@" "${PAYLOADARGS[@]}" "${LINEARARGS[@]}" -s "${PREFIX}${FILENOSLASH}.avg.txt" -d "${PREFIX}${FILENOSLASH}.csv" "${FILE}" "${PREFIX}${WORST}" 2>&1 > "${PREFIX}${FILENOSLASH}.out.txt"
+	if [ -n "${PESQ}" ]
+	then
+		./runNonFree.sh
+	fi
+
+	# Only a run that finished is worth keeping
+	if grep -q "Finished" "${PREFIX}${FILENOSLASH}.out.txt"
+	then
+		mkdir -p "${ENTRY}"
+		for f in "${RESULTS[@]}"
+		do
+			[ -f "${f}" ] && cp "${f}" "${ENTRY}/"
+		done
+		touch "${ENTRY}/complete"
+	fi
+	MISSES=$((MISSES + 1))
+	echo "miss ${FILE} ${BINARY} $*" >> "${CACHE_DIR}/report.log"
+}
 
 # Run the algorithms giving a worst-case scenario
 for j in 0 1 3
 do
 	export PREFIX=`echo "aoki-j=${j}/"`
 	mkdir "${PREFIX}" 2>&1 > /dev/null
-	./main-aoki -j "${j}" -s "${PREFIX}${FILENOSLASH}.avg.txt" -d "${PREFIX}${FILENOSLASH}.csv" "${FILE}" "${PREFIX}${WORST}" 2>&1 > "${PREFIX}${FILENOSLASH}.out.txt"
-	./runNonFree.sh
+	runCached ./main-aoki -j "${j}"
 done
 
 for b in 16000 24000 32000 40000
 do
 	export PREFIX=`echo "ito-b=${b}/"`
 	mkdir "${PREFIX}" 2>&1 > /dev/null
-	./main-ito -b "${b}" -s "${PREFIX}${FILENOSLASH}.avg.txt" -d "${PREFIX}${FILENOSLASH}.csv" "${FILE}" "${PREFIX}${WORST}" 2>&1 > "${PREFIX}${FILENOSLASH}.out.txt"
-	./runNonFree.sh
+	runCached ./main-ito -b "${b}"
 done
 
 export PREFIX=`echo "lsb-work/"`
 mkdir "${PREFIX}" 2>&1 > /dev/null
-./main-lsb -s "${PREFIX}${FILENOSLASH}.avg.txt" -d "${PREFIX}${FILENOSLASH}.csv" "${FILE}" "${PREFIX}${WORST}" 2>&1 > "${PREFIX}${FILENOSLASH}.out.txt"
-./runNonFree.sh
+runCached ./main-lsb
 
 for ((k=2;k<20;k+=2))
 do
@@ -33,8 +113,7 @@ do
 	do
 		export PREFIX=`echo "miao-k=${k}-l=${l}/"`
 		mkdir "${PREFIX}" 2>&1 > /dev/null
-		./main-miao -k "${k}" -l "${l}" -s "${PREFIX}${FILENOSLASH}.avg.txt" -d "${PREFIX}${FILENOSLASH}.csv" "${FILE}" "${PREFIX}${WORST}" 2>&1 > "${PREFIX}${FILENOSLASH}.out.txt"
-		./runNonFree.sh
+		runCached ./main-miao -k "${k}" -l "${l}"
 	done
 done
 
@@ -42,6 +121,7 @@ for b in 16000 24000 32000 40000
 do
 	export PREFIX=`echo "neal-b=${b}/"`
 	mkdir "${PREFIX}" 2>&1 > /dev/null
-	./main-neal -b "${b}" -s "${PREFIX}${FILENOSLASH}.avg.txt" -d "${PREFIX}${FILENOSLASH}.csv" "${FILE}" "${PREFIX}${WORST}" 2>&1 > "${PREFIX}${FILENOSLASH}.out.txt"
-	./runNonFree.sh
+	runCached ./main-neal -b "${b}"
 done
+
+echo "${FILE}: ${HITS} cached, ${MISSES} computed"